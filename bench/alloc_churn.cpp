@@ -0,0 +1,144 @@
+// Spawns and despawns a random mix of entities against a vertex pool and
+// compares how BlockAllocator and RangeAllocator hold up.
+// Usage: bench/alloc_churn [steps] [pool vertices] [block vertices]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "Memmanage.hpp"
+
+struct EntityClass {
+    const char* name;
+    double weight;
+    size_t minVerts;
+    size_t maxVerts;
+};
+
+// Roughly what a scene spawns: a few planets and moons among many small
+// asteroids and ships.
+static const EntityClass kClasses[] = {
+    {"planet",   0.02, 257 * 257, 1025 * 1025},
+    {"moon",     0.08, 65 * 65,   257 * 257},
+    {"asteroid", 0.60, 1000,      5000},
+    {"ship",     0.30, 200,       2000},
+};
+
+struct ChurnStats {
+    size_t spawned = 0;
+    size_t failed = 0;
+    double liveSum = 0.0;
+    double usedSum = 0.0;
+    double reservedSum = 0.0;
+    double ms = 0.0;
+};
+
+// Adapts BlockAllocator to the same interface: whole blocks per entity, one
+// contiguous run each, as EntitySprite needed before ranges.
+class BlockPool {
+public:
+    BlockPool(size_t capacity, size_t blockSize) : m_alloc(capacity, blockSize) {}
+
+    size_t allocate(size_t size)
+    {
+        size_t count = (size + m_alloc.blockSize() - 1) / m_alloc.blockSize();
+        size_t first = m_alloc.allocateContiguous(count);
+        m_reserved += count * m_alloc.blockSize();
+        return first;
+    }
+
+    void deallocate(size_t offset, size_t size)
+    {
+        size_t count = (size + m_alloc.blockSize() - 1) / m_alloc.blockSize();
+        for (size_t i = 0; i < count; ++i)
+            m_alloc.deallocate(offset + i * m_alloc.blockSize());
+        m_reserved -= count * m_alloc.blockSize();
+    }
+
+    size_t reserved() const { return m_reserved; }
+
+private:
+    BlockAllocator m_alloc;
+    size_t m_reserved = 0;
+};
+
+class RangePool {
+public:
+    explicit RangePool(size_t capacity) : m_alloc(capacity) {}
+
+    size_t allocate(size_t size) { return m_alloc.allocate(size); }
+    void deallocate(size_t offset, size_t) { m_alloc.deallocate(offset); }
+    size_t reserved() const { return m_alloc.usedSpace(); }
+    size_t largestFree() const { return m_alloc.largestFree(); }
+
+private:
+    RangeAllocator m_alloc;
+};
+
+template<class Pool>
+static ChurnStats churn(Pool& pool, size_t steps, uint64_t seed)
+{
+    std::mt19937_64 gen(seed);
+    std::discrete_distribution<size_t> pick({kClasses[0].weight, kClasses[1].weight, kClasses[2].weight, kClasses[3].weight});
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+    struct Live { size_t offset; size_t size; };
+    std::vector<Live> live;
+    size_t used = 0;
+    ChurnStats stats;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t step = 0; step < steps; ++step) {
+        // Lean towards spawning while the scene is small so it fills up.
+        bool spawn = live.empty() || coin(gen) < (live.size() < 64 ? 0.7 : 0.5);
+        if (spawn) {
+            const EntityClass& cls = kClasses[pick(gen)];
+            size_t size = std::uniform_int_distribution<size_t>(cls.minVerts, cls.maxVerts)(gen);
+            try {
+                live.push_back({pool.allocate(size), size});
+                used += size;
+                stats.spawned++;
+            } catch (const std::out_of_range&) {
+                stats.failed++;
+            }
+        } else {
+            size_t i = std::uniform_int_distribution<size_t>(0, live.size() - 1)(gen);
+            pool.deallocate(live[i].offset, live[i].size);
+            used -= live[i].size;
+            live[i] = live.back();
+            live.pop_back();
+        }
+        stats.liveSum += live.size();
+        stats.usedSum += used;
+        stats.reservedSum += pool.reserved();
+    }
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return stats;
+}
+
+static void report(const char* name, const ChurnStats& s, size_t steps, size_t capacity)
+{
+    std::printf("%-8s %9zu %8zu %9.1f %8.1f%% %8.1f%% %9.1f\n", name, s.spawned, s.failed,
+        s.liveSum / steps, 100.0 * s.usedSum / steps / capacity,
+        100.0 * (s.reservedSum - s.usedSum) / steps / capacity, 1e6 * s.ms / steps);
+}
+
+int main(int argc, char** argv)
+{
+    size_t steps = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    size_t capacity = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 3000000;
+    size_t blockSize = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 300000;
+
+    std::printf("%zu steps over a %zu vertex pool, %zu vertex blocks\n", steps, capacity, blockSize);
+    std::printf("%-8s %9s %8s %9s %9s %9s %9s\n", "pool", "spawned", "failed", "avg live", "used", "wasted", "ns/op");
+
+    BlockPool blocks(capacity, blockSize);
+    report("block", churn(blocks, steps, 42), steps, capacity);
+
+    RangePool ranges(capacity);
+    report("range", churn(ranges, steps, 42), steps, capacity);
+    std::printf("range pool at the end: largest free range %zu of %zu free\n",
+        ranges.largestFree(), capacity - ranges.reserved());
+    return 0;
+}
@@ -0,0 +1,50 @@
+// Times PlanetArray::fractal() and mesh<P_N_C>() for increasing thread counts.
+// Usage: bench/planet_gen [nTheta] [nPhi]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "ProcGen.hpp"
+
+static double ms_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char** argv)
+{
+    size_t nTheta = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1024;
+    size_t nPhi = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1024;
+    unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::printf("%zux%zu planet, %u hardware threads\n", nTheta, nPhi, max_threads);
+    std::printf("%8s %12s %12s %12s %9s\n", "threads", "fractal ms", "mesh ms", "total ms", "speedup");
+
+    // 1, 2, 4, ... and finally every hardware thread.
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < max_threads; threads *= 2)
+        counts.push_back(threads);
+    counts.push_back(max_threads);
+
+    double base = 0.0;
+    for (unsigned threads : counts) {
+        PlanetArray planet(nTheta, nPhi, 32., HeightFormat::Quantized16);
+        planet.setThreads(threads);
+
+        auto t0 = std::chrono::steady_clock::now();
+        planet.fractal(1234);
+        double fractal_ms = ms_since(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        auto mesh = planet.mesh<P_N_C>();
+        double mesh_ms = ms_since(t0);
+
+        double total = fractal_ms + mesh_ms;
+        if (threads == 1)
+            base = total;
+        std::printf("%8u %12.1f %12.1f %12.1f %8.2fx\n", threads, fractal_ms, mesh_ms, total, base / total);
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include <span>
+
+#include "common.hpp"
+
+// Most triangles per culling chunk: meshes are drawn as runs of their
+// index list, each with its own bounding sphere, so the parts of a mesh
+// outside the view are skipped. MeshOpt groups index lists into compact
+// patches of at most this many triangles and reports where each starts.
+// A chunk only faces away once all its faces do, so on rough terrain
+// smaller chunks cull more, at the cost of more draws.
+constexpr size_t CULL_CHUNK_TRIANGLES = 1024;
+constexpr size_t CULL_CHUNK_INDICES = 3 * CULL_CHUNK_TRIANGLES;
+
+// Where the culling chunks of an index list start, followed by its size:
+// chunk k is indices [chunks[k], chunks[k + 1]).
+using ChunkOffsets = std::vector<size_t>;
+
+// Chunks cut every CULL_CHUNK_INDICES, for index lists that were not
+// clustered.
+ChunkOffsets uniformChunks(size_t index_count);
+
+// A bounding sphere in world space. One with an infinite radius (the
+// default) is never culled.
+struct BoundingSphere {
+    glm::vec3 center{0.0f};
+    float radius = INFINITY;
+};
+
+// The six clip planes of a view, normalized and facing inwards, so
+// dot(plane, (p, 1)) is the signed distance of p from the plane.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Planes of the clip volume of view_proj (Gribb and Hartmann).
+    explicit Frustum(const glm::mat4& view_proj);
+
+    // Whether any part of sphere may be in view.
+    bool intersects(const BoundingSphere& sphere) const;
+};
+
+// Cone around the normals of a chunk's faces. With bounding sphere (c, r),
+// every face points away from eye e when
+//   dot(c - e, axis) >= cutoff * |c - e| + r.
+// A cutoff of 1 (the default) never culls.
+struct NormalCone {
+    glm::vec3 axis{0.0f};
+    float cutoff = 1.0f;
+};
+
+// Solid sphere inside a surface, e.g. a planet below its lowest point, that
+// hides whatever lies past its horizon. A radius of 0 hides nothing.
+struct Occluder {
+    glm::vec3 center{0.0f};
+    float radius = 0.0f;
+};
+
+// What the culling pass knows about one draw.
+struct ChunkBounds {
+    BoundingSphere sphere;
+    NormalCone cone;
+    Occluder occluder;
+};
+
+// Visible and culled draws of the last cull; culled counts every test.
+struct CullStats {
+    size_t visible = 0;
+    size_t culled = 0;
+    size_t backfacing = 0;   // of culled: facing away from the eye
+    size_t beyondHorizon = 0; // of culled: hidden by their occluder
+    size_t occluded = 0;     // of culled: behind the OcclusionBuffer's depth
+};
+
+// Whether every face of a chunk with this cone and sphere faces away from
+// eye.
+bool facesAway(const NormalCone& cone, const BoundingSphere& sphere, const glm::vec3& eye);
+
+// Whether all of sphere lies past the horizon of occluder seen from eye.
+bool beyondHorizon(const Occluder& occluder, const BoundingSphere& sphere, const glm::vec3& eye);
+
+// Tests n spheres, stored as separate x, y, z and radius arrays, against
+// frustum: visible[k] is 1 where sphere k may be in view, else 0. Returns
+// the number visible. Runs 8 (AVX2) or 4 (SSE4.1) spheres per step where
+// the CPU allows.
+size_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* r,
+                   uint8_t* visible, size_t n);
+
+// Bounding sphere of the points position(k) for k in indices: the center
+// of their box and the farthest of them from it.
+template<typename Position>
+BoundingSphere boundingSphere(std::span<const unsigned int> indices, Position&& position)
+{
+    if (indices.empty())
+        return {};
+
+    glm::vec3 lo(INFINITY), hi(-INFINITY);
+    for (unsigned int k : indices) {
+        glm::vec3 p = position(k);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    BoundingSphere sphere{(lo + hi) * 0.5f, 0.0f};
+    float radius2 = 0.0f;
+    for (unsigned int k : indices) {
+        glm::vec3 d = position(k) - sphere.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    sphere.radius = std::sqrt(radius2);
+    return sphere;
+}
+
+// Cone of the face normals of the triangles in indices, each turned to
+// point away from center (the surface is taken to be a height field around
+// it, so winding does not matter). Cones wider than ~84 degrees, which
+// would rarely cull, get cutoff 1.
+template<typename Position>
+NormalCone normalCone(std::span<const unsigned int> indices, const glm::vec3& center, Position&& position)
+{
+    std::vector<glm::vec3> normals;
+    normals.reserve(indices.size() / 3);
+    glm::vec3 sum(0.0f);
+    for (size_t t = 0; t + 3 <= indices.size(); t += 3) {
+        glm::vec3 a = position(indices[t]), b = position(indices[t + 1]), c = position(indices[t + 2]);
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        if (!(length > 0.0f))
+            continue; // degenerate
+        n /= length;
+        if (glm::dot(n, (a + b + c) / 3.0f - center) < 0.0f)
+            n = -n;
+        normals.push_back(n);
+        sum += n;
+    }
+
+    NormalCone cone;
+    float length = glm::length(sum);
+    if (normals.empty() || !(length > 0.0f))
+        return cone;
+    glm::vec3 axis = sum / length;
+    float min_dot = 1.0f;
+    for (const auto& n : normals)
+        min_dot = std::min(min_dot, glm::dot(axis, n));
+    if (min_dot <= 0.1f)
+        return cone;
+    cone.axis = axis;
+    cone.cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    return cone;
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef DISPLACEDPLANET_HPP
+#define DISPLACEDPLANET_HPP
+
+#include <optional>
+
+#include "common.hpp"
+#include "ProcGen.hpp"
+#include "Shader.hpp"
+#include "Sprite.hpp"
+#include "TransformPool.hpp"
+
+// What a DisplacedPlanet is drawn from, built off the GL thread: the height
+// grid and the noise its biome colors are varied by.
+struct PlanetSurface {
+    PlanetArray heights;
+    ShadingNoise noise;
+};
+
+// A planet drawn without a vertex mesh. Its heights (R16 snorm, or R32F for
+// float grids) and color noise live in textures, and shad/PNC_displaced
+// places, colors and lights the shared LatLong index list of its resolution
+// from them, so it holds about 3 bytes per sample on the GPU instead of a
+// 16 or 36 byte vertex and no vertices are built on the CPU. Like
+// EntitySprite, it is placed by a model matrix in a TransformPool slot.
+class DisplacedPlanet : public BaseSprite
+{
+public:
+    // What BasicPlanetLoader needs to build one.
+    struct Context {
+        std::shared_ptr<TopologyCache> topologies;
+        std::shared_ptr<TransformPool> transforms;
+    };
+    using Payload = PlanetSurface;
+
+    // Takes the output of generate() for the same nTheta, nPhi and rad.
+    DisplacedPlanet(const glm::vec3& pos, const glm::vec3& euler_angles, std::shared_ptr<TopologyCache> topologies,
+                    PlanetSurface surface, int nTheta = 1024, int nPhi = 1024, double rad = 32.);
+
+    DisplacedPlanet(const DisplacedPlanet&) = delete;
+    DisplacedPlanet& operator=(const DisplacedPlanet&) = delete;
+
+    ~DisplacedPlanet();
+
+    // Generates the heights (or maps them from cache, which shares entries
+    // with Planet) and the color noise. Touches no GL state.
+    static PlanetSurface generate(const glm::vec3& pos, unsigned long long seed, int nTheta, int nPhi, double rad,
+                                  unsigned threads = 0, MeshCache* cache = nullptr);
+
+    // Builds the shared index list of this resolution ahead of create().
+    // Touches no GL state.
+    static void prepare(const Context& context, int nTheta, int nPhi);
+
+    static std::unique_ptr<DisplacedPlanet> create(const Context& context, const glm::vec3& pos, const glm::vec3& euler_angles,
+                                                   unsigned long long seed, Payload surface, int nTheta, int nPhi, double rad);
+
+    // Uploads the textures a slice of rows at a time, at most about
+    // byte_budget bytes per call, and returns the bytes used.
+    size_t shipSome(size_t byte_budget);
+    void ship() { shipSome(SIZE_MAX); }
+    bool shipped() const { return !m_surface; }
+
+    // Draws this planet through a slot of pool holding its model matrix,
+    // so setTransform() can move it.
+    void setTransforms(std::shared_ptr<TransformPool> pool);
+
+    // Moves and turns the planet; only its model matrix is uploaded (with
+    // the next TransformPool::upload()).
+    void setTransform(const glm::vec3& pos, const glm::vec3& euler_angles);
+
+    const glm::vec3& position() const { return m_pos; }
+    const glm::mat4& modelMatrix() const { return m_model_matrix; }
+
+    // The uniforms draw() sets through shader, resolved once per shader.
+    struct Uniforms {
+        const Shader& shader;
+        Shader::Uniform heights, biome, polar;
+        Shader::Uniform nTheta, nPhi;
+        Shader::Uniform heightBias, heightScale, nominalRad;
+        explicit Uniforms(const Shader& shader);
+    };
+
+    // Draws the planet with the shader (shad/PNC_displaced) uniforms were
+    // resolved from bound, and the DynIBO holding its topology and its
+    // TransformPool's attributes (bindAttributes()) bound to the current
+    // VAO. Uses texture units 0-2.
+    void draw(const Uniforms& uniforms) const;
+
+    // Texture memory held on the GPU.
+    size_t gpuBytes() const;
+
+    // Sphere the displaced surface stays within, for culling.
+    BoundingSphere bounds() const { return {m_pos, static_cast<float>(m_rad + Planet::HEIGHT_RANGE)}; }
+    // Sphere below the lowest point of the surface, for occlusion.
+    Occluder core() const { return {m_pos, static_cast<float>(m_rad - Planet::HEIGHT_RANGE)}; }
+
+private:
+    enum Tex { HEIGHTS, BIOME, POLAR, TEX_COUNT };
+
+    int m_nTheta;
+    int m_nPhi;
+    double m_rad;
+    std::shared_ptr<SharedTopology> m_topology;
+    // Without a pool it is drawn at the origin (slot 0, the identity).
+    std::shared_ptr<TransformPool> m_transforms;
+    TransformPool::Slot m_transform_slot = TransformPool::INVALID;
+
+    // radius = m_height_bias + m_height_scale * (height texel)
+    float m_height_bias = 0.0f;
+    float m_height_scale = 1.0f;
+    GLenum m_height_internal;
+
+    GLuint m_textures[TEX_COUNT];
+    // Released once everything is uploaded.
+    std::optional<PlanetSurface> m_surface;
+    size_t m_height_rows = 0;
+    size_t m_biome_rows = 0;
+};
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef DRAWLIST_HPP
+#define DRAWLIST_HPP
+
+#include <span>
+#include <stdexcept>
+
+#include "common.hpp"
+#include "Culling.hpp"
+#include "Occlusion.hpp"
+
+// Layout read by glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// GPU-resident list of indirect draw commands. Each entity owns a segment of
+// slots and patches it only when its draws change (ship, relocation, free);
+// a frame is then a single glMultiDrawElementsIndirect with no allocations.
+// Freed slots are zeroed (count 0 draws nothing) and reused by later segments;
+// neighbouring free slots merge, and free slots at the end are dropped, so
+// draw() stops submitting them.
+//
+// Every slot also has ChunkBounds. The bounding spheres are kept in separate
+// x/y/z/radius arrays; cull() tests them all against the view at once, then
+// the survivors against their normal cone and occluder, and switches each
+// draw on or off through its instanceCount, so hidden draws cost the GPU
+// next to nothing. An OcclusionBuffer, when given, also hides draws behind
+// other bodies.
+class DrawList {
+public:
+    using Handle = size_t;
+    static constexpr Handle INVALID = static_cast<Handle>(-1);
+
+    explicit DrawList(size_t capacity = 256)
+        : m_capacity(std::max<size_t>(capacity, 1))
+    {
+        glGenBuffers(1, &m_id);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_id);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, m_capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+        m_commands.reserve(m_capacity);
+    }
+
+    DrawList(const DrawList&) = delete;
+    DrawList& operator=(const DrawList&) = delete;
+
+    ~DrawList() { glDeleteBuffers(1, &m_id); }
+
+    // Reserves size command slots and returns their segment.
+    Handle allocate(size_t size)
+    {
+        Segment seg{0, size, true};
+
+        auto fit = std::find_if(m_free.begin(), m_free.end(), [&](const Segment& f) { return f.size >= size; });
+        if (fit != m_free.end()) {
+            seg.first = fit->first;
+            // Keep whatever the new segment does not use on the free list.
+            if (fit->size > size)
+                *fit = {fit->first + size, fit->size - size, false};
+            else
+                m_free.erase(fit);
+        } else {
+            seg.first = m_commands.size();
+            m_commands.resize(m_commands.size() + size, DrawElementsIndirectCommand{});
+            BoundingSphere unbounded;
+            m_bound_x.resize(m_commands.size(), unbounded.center.x);
+            m_bound_y.resize(m_commands.size(), unbounded.center.y);
+            m_bound_z.resize(m_commands.size(), unbounded.center.z);
+            m_bound_r.resize(m_commands.size(), unbounded.radius);
+            m_cones.resize(m_commands.size());
+            m_occluders.resize(m_commands.size());
+            m_instances.resize(m_commands.size(), 0);
+            m_visible.resize(m_commands.size(), 1);
+            markDirty(seg.first, seg.first + size);
+        }
+
+        if (!m_free_handles.empty()) {
+            Handle h = m_free_handles.back();
+            m_free_handles.pop_back();
+            m_segments[h] = seg;
+            return h;
+        }
+        m_segments.push_back(seg);
+        return m_segments.size() - 1;
+    }
+
+    // Overwrites a segment's commands; slots past cmds.size() are cleared.
+    // bounds, if given, holds the bounds of each command; draws without them
+    // are never culled.
+    void set(Handle h, std::span<const DrawElementsIndirectCommand> cmds, std::span<const ChunkBounds> bounds = {})
+    {
+        const Segment& seg = m_segments.at(h);
+        if (!seg.live || cmds.size() > seg.size)
+            throw std::out_of_range("Draw commands do not fit their segment");
+        if (!bounds.empty() && bounds.size() != cmds.size())
+            throw std::invalid_argument("Draw bounds do not match the commands");
+
+        std::copy(cmds.begin(), cmds.end(), m_commands.begin() + seg.first);
+        for (size_t k = 0; k < seg.size; ++k) {
+            size_t slot = seg.first + k;
+            setSlotBounds(slot, k < bounds.size() ? bounds[k] : ChunkBounds{});
+            // Keep what the last cull decided until the next one.
+            m_instances[slot] = k < cmds.size() ? cmds[k].instanceCount : 0;
+            m_commands[slot].instanceCount = m_visible[slot] ? m_instances[slot] : 0;
+        }
+        std::fill(m_commands.begin() + seg.first + cmds.size(), m_commands.begin() + seg.first + seg.size, DrawElementsIndirectCommand{});
+        markDirty(seg.first, seg.first + seg.size);
+    }
+
+    // Replaces the bounds of a segment's first bounds.size() commands, e.g.
+    // after its entity moved; the commands stay as they are.
+    void setBounds(Handle h, std::span<const ChunkBounds> bounds)
+    {
+        const Segment& seg = m_segments.at(h);
+        if (!seg.live || bounds.size() > seg.size)
+            throw std::out_of_range("Draw bounds do not fit their segment");
+        for (size_t k = 0; k < bounds.size(); ++k)
+            setSlotBounds(seg.first + k, bounds[k]);
+    }
+
+    size_t segmentSize(Handle h) const { return m_segments.at(h).size; }
+
+    void release(Handle h)
+    {
+        Segment& seg = m_segments.at(h);
+        if (!seg.live)
+            throw std::invalid_argument("Draw segment released twice");
+
+        std::fill(m_commands.begin() + seg.first, m_commands.begin() + seg.first + seg.size, DrawElementsIndirectCommand{});
+        std::fill(m_instances.begin() + seg.first, m_instances.begin() + seg.first + seg.size, 0);
+        markDirty(seg.first, seg.first + seg.size);
+        addFree(seg.first, seg.size);
+        seg.live = false;
+        m_free_handles.push_back(h);
+    }
+
+    // Tests every draw's bounds against frustum, and those in it against
+    // their normal cone and occluder as seen from eye, then against
+    // occlusion if given, and switches draws on or off for the following
+    // draw() calls. Slots that draw nothing are not counted.
+    CullStats cull(const Frustum& frustum, const glm::vec3& eye, const OcclusionBuffer* occlusion = nullptr)
+    {
+        cullSpheres(frustum, m_bound_x.data(), m_bound_y.data(), m_bound_z.data(), m_bound_r.data(),
+                    m_visible.data(), m_commands.size());
+
+        CullStats stats;
+        for (size_t k = 0; k < m_commands.size(); ++k) {
+            auto& command = m_commands[k];
+            if (command.count == 0)
+                continue;
+            if (m_visible[k]) {
+                BoundingSphere sphere{glm::vec3(m_bound_x[k], m_bound_y[k], m_bound_z[k]), m_bound_r[k]};
+                if (facesAway(m_cones[k], sphere, eye)) {
+                    m_visible[k] = 0;
+                    stats.backfacing++;
+                } else if (beyondHorizon(m_occluders[k], sphere, eye)) {
+                    m_visible[k] = 0;
+                    stats.beyondHorizon++;
+                } else if (occlusion && occlusion->occluded(sphere)) {
+                    m_visible[k] = 0;
+                    stats.occluded++;
+                }
+            }
+            GLuint instances = m_visible[k] ? m_instances[k] : 0;
+            (m_visible[k] ? stats.visible : stats.culled)++;
+            if (command.instanceCount != instances) {
+                command.instanceCount = instances;
+                markDirty(k, k + 1);
+            }
+        }
+        m_cull_stats = stats;
+        return stats;
+    }
+
+    // Counters of the last cull().
+    const CullStats& cullStats() const { return m_cull_stats; }
+
+    // Uploads patched commands (if any) and issues every draw in one call.
+    // The caller binds the VAO, vertex and index buffers.
+    void draw(GLenum mode = GL_TRIANGLES)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_id);
+        flush();
+        if (!m_commands.empty())
+            glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(m_commands.size()), 0);
+    }
+
+    // Slots submitted per draw(), including cleared ones.
+    size_t commandCount() const { return m_commands.size(); }
+
+    GLuint getID() const { return m_id; }
+
+private:
+    struct Segment {
+        size_t first;
+        size_t size;
+        bool live;
+    };
+
+    // Puts [first, first + size) on the free list, which stays sorted,
+    // merged with the free segments either side; a free run reaching the
+    // last slot is cut off instead.
+    void addFree(size_t first, size_t size)
+    {
+        auto next = std::lower_bound(m_free.begin(), m_free.end(), first, [](const Segment& f, size_t slot) { return f.first < slot; });
+        if (next != m_free.end() && first + size == next->first) {
+            size += next->size;
+            next = m_free.erase(next);
+        }
+        if (next != m_free.begin() && std::prev(next)->first + std::prev(next)->size == first) {
+            first = std::prev(next)->first;
+            size += std::prev(next)->size;
+            next = m_free.erase(std::prev(next));
+        }
+        if (first + size == m_commands.size())
+            shrink(first);
+        else
+            m_free.insert(next, {first, size, false});
+    }
+
+    // Drops every slot from slot_count on. The GPU buffer keeps its size.
+    void shrink(size_t slot_count)
+    {
+        m_commands.resize(slot_count);
+        m_bound_x.resize(slot_count);
+        m_bound_y.resize(slot_count);
+        m_bound_z.resize(slot_count);
+        m_bound_r.resize(slot_count);
+        m_cones.resize(slot_count);
+        m_occluders.resize(slot_count);
+        m_instances.resize(slot_count);
+        m_visible.resize(slot_count);
+        m_dirty_end = std::min(m_dirty_end, slot_count);
+    }
+
+    void setSlotBounds(size_t slot, const ChunkBounds& chunk)
+    {
+        m_bound_x[slot] = chunk.sphere.center.x;
+        m_bound_y[slot] = chunk.sphere.center.y;
+        m_bound_z[slot] = chunk.sphere.center.z;
+        m_bound_r[slot] = chunk.sphere.radius;
+        m_cones[slot] = chunk.cone;
+        m_occluders[slot] = chunk.occluder;
+    }
+
+    void markDirty(size_t begin, size_t end)
+    {
+        m_dirty_begin = std::min(m_dirty_begin, begin);
+        m_dirty_end = std::max(m_dirty_end, end);
+    }
+
+    // Expects the buffer to be bound to GL_DRAW_INDIRECT_BUFFER.
+    void flush()
+    {
+        if (m_commands.size() > m_capacity) {
+            while (m_capacity < m_commands.size())
+                m_capacity *= 2;
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, m_capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+            m_dirty_begin = 0;
+            m_dirty_end = m_commands.size();
+        }
+        if (m_dirty_begin >= m_dirty_end)
+            return;
+
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, m_dirty_begin * sizeof(DrawElementsIndirectCommand),
+            (m_dirty_end - m_dirty_begin) * sizeof(DrawElementsIndirectCommand), m_commands.data() + m_dirty_begin);
+        m_dirty_begin = SIZE_MAX;
+        m_dirty_end = 0;
+    }
+
+    GLuint m_id;
+    size_t m_capacity;
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    // Per slot, parallel to m_commands.
+    std::vector<float> m_bound_x, m_bound_y, m_bound_z, m_bound_r;
+    std::vector<NormalCone> m_cones;
+    std::vector<Occluder> m_occluders;
+    std::vector<GLuint> m_instances; // instanceCount when visible
+    std::vector<uint8_t> m_visible;
+    CullStats m_cull_stats;
+    std::vector<Segment> m_segments;
+    std::vector<Segment> m_free; // by first slot
+    std::vector<Handle> m_free_handles;
+    size_t m_dirty_begin = SIZE_MAX;
+    size_t m_dirty_end = 0;
+};
+
+#endif
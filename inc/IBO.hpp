@@ -3,7 +3,7 @@
 
 #include "common.hpp"
 
-#include "Memmanage.hpp"
+#include "RangeBuffer.hpp"
 
 class IBO {
 public:
@@ -44,32 +44,21 @@ private:
     unsigned int m_Count;
 };
 
-class DynIBO {
+class DynIBO : public RangeBuffer {
 public:
     // Constructs a dynamic index buffer with allocated space for 'count' indices.
-    DynIBO(unsigned int count, int block_size = -1)
-        : m_Count(count + 1)
+    DynIBO(unsigned int count)
+        : RangeBuffer(sizeof(unsigned int), count)
     {
-        glGenBuffers(1, &m_ID);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-        allocator = (std::make_shared<BlockAllocator>(count, block_size < 0 ? count : block_size)); // Initialize allocator with count and block size of 1
-
         if constexpr (DEBUG_IBO)
         {
-            std::cout << "DynIBO created with ID: " << m_ID << ", Count: " << m_Count << ", Block Size: " << allocator->blockSize() << std::endl;
+            std::cout << "DynIBO created with ID: " << getID() << ", Count: " << getCount() << std::endl;
         }
     }
 
-    // Deletes the dynamic index buffer.
-    ~DynIBO() {
-        glDeleteBuffers(1, &m_ID);
-    }
-
     // Binds the dynamic index buffer.
     void bind() const {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, getID());
     }
 
     // Unbinds the dynamic index buffer.
@@ -82,12 +71,10 @@ public:
 
         if constexpr (DEBUG_IBO)
         {
-            std::cout << "Loading data into DynIBO with ID: " << m_ID << ", Count: " << m_Count << ", Data Size: " << count << ", Offset: " << offset << std::endl;
+            std::cout << "Loading data into DynIBO with ID: " << getID() << ", Count: " << getCount() << ", Data Size: " << count << ", Offset: " << offset << std::endl;
         }
 
-        bind();
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset * sizeof(unsigned int), count * sizeof(unsigned int), indices);
-        unbind();
+        upload(offset, indices, count);
     }
 
     void loadData(const std::vector<unsigned int>& data, GLsizeiptr idx = 0){
@@ -95,12 +82,12 @@ public:
             std::cerr << "Error: Attempting to load empty data into VBO." << std::endl;
             return;
         }
-        if (data.size() >= m_Count) {
+        if (data.size() > getCount()) {
             std::cerr << "Error: Data size exceeds VBO capacity." << std::endl;
             return;
         }
 
-        if (data.size() + idx > m_Count)
+        if (data.size() + idx > getCount())
         {
             std::cerr << "Error: Data size plus offset exceeds VBO capacity." << std::endl;
             return;
@@ -111,13 +98,18 @@ public:
     }
 
     // Returns the maximum number of indices the buffer can hold.
-    unsigned int getCount() const { return m_Count; }
+    unsigned int getCount() const { return static_cast<unsigned int>(capacity()); }
 
-    std::shared_ptr<BlockAllocator> allocator;
+protected:
+    // The element array binding belongs to the VAO, so re-bind the new buffer.
+    void rebind() override {
+        bind();
 
-private:
-    unsigned int m_ID;
-    unsigned int m_Count;
+        if constexpr (DEBUG_IBO)
+        {
+            std::cout << "DynIBO resized to ID: " << getID() << ", Count: " << getCount() << std::endl;
+        }
+    }
 };
 
 #endif // IBO_HPP
\ No newline at end of file
@@ -0,0 +1,167 @@
+#ifndef INSTANCEDSPRITE_HPP
+#define INSTANCEDSPRITE_HPP
+
+#include <span>
+#include <stdexcept>
+
+#include "Sprite.hpp"
+
+// Many copies of one small mesh, e.g. asteroids, debris or moons: the mesh
+// is shipped once and every culling chunk is a single indirect command
+// drawing all copies, each reading its model matrix and tint from its own
+// TransformPool slot. Instance matrices are relative to the entity's model
+// matrix, so setTransform() moves the whole field. The field culls as a
+// whole, one sphere around all instances per chunk.
+template<HasAttribPointer V = P_N_C>
+class InstancedSprite : public EntitySprite<V>
+{
+public:
+    static constexpr bool PACKED = std::is_same_v<V, P_N_C_Packed>;
+
+    // Takes the base mesh, e.g. from createSpherePNC() or
+    // PlanetArray::mesh<P_N_C>(), packing it when V is P_N_C_Packed, and
+    // reserves count slots of transforms; instances start at the identity.
+    // chunks are the mesh's culling chunks if optimizeMesh() set them.
+    InstancedSprite(const glm::vec3& pos, const glm::vec3& euler_angles, std::pair<std::vector<P_N_C>, std::vector<unsigned int>> mesh,
+                    size_t count, std::shared_ptr<DynVBO<V>> vbo, std::shared_ptr<DynIBO> ibo, std::shared_ptr<TransformPool> transforms,
+                    ChunkOffsets chunks = {})
+        : EntitySprite<V>(pos, euler_angles, vbo, ibo), m_instance_models(std::max<size_t>(count, 1), glm::mat4(1.0f))
+    {
+        if (!transforms)
+            throw std::logic_error("Instanced sprites need a transform pool");
+        auto& [vertices, indices] = mesh;
+        if constexpr (PACKED) {
+            PackedBounds bounds = packedBounds(vertices);
+            this->m_vertices.reserve(vertices.size());
+            for (const P_N_C& v : vertices)
+                this->m_vertices.emplace_back(v, bounds);
+            this->setBounds(bounds);
+        } else {
+            this->m_vertices = std::move(vertices);
+        }
+        this->m_indices = std::move(indices);
+        this->m_chunks = std::move(chunks);
+        this->m_instance_count = m_instance_models.size();
+        this->setTransforms(transforms);
+    }
+
+    // The mesh comes from the constructor.
+    void mesh() override {}
+
+    size_t instanceCount() const { return m_instance_models.size(); }
+    const glm::mat4& instance(size_t k) const { return m_instance_models[k]; }
+
+    // Places and colors instance k. The field's culling sphere only grows
+    // to take it in; setInstances() fits it again.
+    void setInstance(size_t k, const glm::mat4& model, const glm::vec4& tint = glm::vec4(1.0f))
+    {
+        if (k >= m_instance_models.size())
+            throw std::out_of_range("Instance index out of range");
+        m_instance_models[k] = model;
+        writeInstance(k);
+        this->m_transforms->setTint(this->m_transform_slot + k, tint);
+        if (this->m_chunk_bounds.size() != this->m_local_chunk_bounds.size())
+            return;
+        for (size_t c = 0; c < this->m_local_chunk_bounds.size(); ++c) {
+            BoundingSphere& field = this->m_chunk_bounds[c].sphere;
+            field = enclose(field, placeSphere(this->m_local_chunk_bounds[c].sphere, this->m_model_matrix * model));
+        }
+        this->pushChunkBounds();
+    }
+
+    // Places (and with tints, colors) instances [first, first + models.size()),
+    // then fits the culling bounds around the whole field.
+    void setInstances(std::span<const glm::mat4> models, std::span<const glm::vec4> tints = {}, size_t first = 0)
+    {
+        if (first + models.size() > m_instance_models.size() || (!tints.empty() && tints.size() != models.size()))
+            throw std::out_of_range("Instance range out of range");
+        for (size_t k = 0; k < models.size(); ++k) {
+            m_instance_models[first + k] = models[k];
+            writeInstance(first + k);
+            if (!tints.empty())
+                this->m_transforms->setTint(this->m_transform_slot + first + k, tints[k]);
+        }
+        this->placeChunkBounds();
+        this->pushChunkBounds();
+    }
+
+protected:
+    // One sphere per chunk around that chunk in every instance. Instances
+    // may scale, so radii grow by the largest axis scale; cones and cores
+    // mean nothing for a field of copies and are left off. Each instance is
+    // placed twice, for the centre and then the radius, rather than keeping
+    // a sphere per instance.
+    void placeChunkBounds() override
+    {
+        this->m_chunk_bounds.assign(this->m_local_chunk_bounds.size(), ChunkBounds{});
+        for (size_t c = 0; c < this->m_local_chunk_bounds.size(); ++c) {
+            const BoundingSphere& local = this->m_local_chunk_bounds[c].sphere;
+            glm::vec3 lo(INFINITY), hi(-INFINITY);
+            for (const glm::mat4& model : m_instance_models) {
+                glm::vec3 center = placeSphere(local, this->m_model_matrix * model).center;
+                lo = glm::min(lo, center);
+                hi = glm::max(hi, center);
+            }
+            BoundingSphere field{(lo + hi) * 0.5f, 0.0f};
+            for (const glm::mat4& model : m_instance_models) {
+                BoundingSphere s = placeSphere(local, this->m_model_matrix * model);
+                field.radius = std::max(field.radius, glm::length(s.center - field.center) + s.radius);
+            }
+            this->m_chunk_bounds[c].sphere = field;
+        }
+    }
+
+    void writeTransform() override
+    {
+        if (!this->m_transforms || this->m_transform_slot == TransformPool::INVALID)
+            return;
+        for (size_t k = 0; k < m_instance_models.size(); ++k)
+            writeInstance(k);
+    }
+
+private:
+    void writeInstance(size_t k)
+    {
+        if (!this->m_transforms || this->m_transform_slot == TransformPool::INVALID)
+            return;
+        glm::mat4 model = this->m_model_matrix * m_instance_models[k];
+        if constexpr (PACKED)
+            model = model * this->m_bounds.frame();
+        this->m_transforms->set(this->m_transform_slot + k, model);
+    }
+
+    static BoundingSphere placeSphere(const BoundingSphere& local, const glm::mat4& model)
+    {
+        float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))});
+        return {glm::vec3(model * glm::vec4(local.center, 1.0f)), local.radius * scale};
+    }
+
+    static BoundingSphere enclose(const BoundingSphere& a, const BoundingSphere& b)
+    {
+        float d = glm::length(b.center - a.center);
+        if (d + b.radius <= a.radius)
+            return a;
+        if (d + a.radius <= b.radius)
+            return b;
+        float radius = (d + a.radius + b.radius) * 0.5f;
+        return {a.center + (b.center - a.center) * ((radius - a.radius) / d), radius};
+    }
+
+    static PackedBounds packedBounds(std::span<const P_N_C> vertices)
+    {
+        glm::vec3 lo(INFINITY), hi(-INFINITY);
+        for (const P_N_C& v : vertices) {
+            lo = glm::min(lo, v.pos);
+            hi = glm::max(hi, v.pos);
+        }
+        if (vertices.empty())
+            return {glm::vec3(0.0f), 1.0f};
+        glm::vec3 half = (hi - lo) * 0.5f;
+        return {(lo + hi) * 0.5f, std::max({half.x, half.y, half.z, 1e-6f})};
+    }
+
+    // Each instance's placement relative to the sprite's model matrix.
+    std::vector<glm::mat4> m_instance_models;
+};
+
+#endif
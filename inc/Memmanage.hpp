@@ -4,6 +4,11 @@
 #include <vector>
 #include <stack>
 #include <stdexcept>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
 
 class BlockAllocator {
 public:
@@ -25,6 +30,27 @@ public:
         return blockIdx * blockSize_;
     }
 
+    // Allocates count adjacent blocks and returns the starting index of the
+    // first, or throws if no such run is free
+    size_t allocateContiguous(size_t count) {
+        if (count == 0)
+            throw std::invalid_argument("Cannot allocate an empty run of blocks");
+        std::vector<bool> isFree(numBlocks_, false);
+        for (size_t block : freeBlocks_)
+            isFree[block] = true;
+
+        size_t run = 0;
+        for (size_t i = 0; i < numBlocks_; ++i) {
+            run = isFree[i] ? run + 1 : 0;
+            if (run == count) {
+                size_t first = i + 1 - count;
+                std::erase_if(freeBlocks_, [&](size_t b) { return b >= first && b <= i; });
+                return first * blockSize_;
+            }
+        }
+        throw std::out_of_range("No contiguous run of free blocks available");
+    }
+
     // Deallocates a block given its starting index
     void deallocate(size_t startIndex) {
         if (startIndex % blockSize_ != 0)
@@ -63,4 +89,353 @@ private:
     std::vector<size_t> freeBlocks_;
 };
 
+// A range handed out by a RangeAllocator, as its owner keeps track of it.
+struct BufferRange {
+    size_t offset = 0;
+    size_t size = 0;
+
+    bool empty() const { return size == 0; }
+};
+
+// Two-level segregated fit (TLSF) allocator over a range of elements, e.g. the
+// vertices of a DynVBO or the indices of a DynIBO. Free ranges are binned by
+// size class (power of two, then SL_COUNT linear steps) into lists found
+// through two bitmaps, so allocate and deallocate are O(1). Freed ranges are
+// merged with free neighbours, so every mesh gets one contiguous range of
+// exactly the size it asked for.
+class RangeAllocator {
+public:
+    explicit RangeAllocator(size_t capacity)
+        : capacity_(capacity)
+    {
+        if (capacity == 0)
+            throw std::invalid_argument("Range allocator needs a non-zero capacity");
+        reset();
+    }
+
+    // Allocates size elements whose offset is a multiple of align and returns
+    // the offset, or throws if no free range is large enough
+    size_t allocate(size_t size, size_t align = 1) {
+        if (size == 0 || align == 0)
+            throw std::invalid_argument("Invalid allocation size or alignment");
+
+        // Rounding the request up to the next size class means any range in
+        // the class found covers it, so the list head can be taken unseen.
+        size_t needed = size + align - 1;
+        size_t search = needed;
+        if (search >= SL_COUNT)
+            search += (size_t(1) << (std::bit_width(search) - 1 - SL_BITS)) - 1;
+        unsigned fl, sl;
+        mapping(search, fl, sl);
+        uint32_t n = findSuitable(fl, sl);
+        if (n == NIL) {
+            // The only fit may share the request's own size class; look
+            // through that list before giving up.
+            mapping(needed, fl, sl);
+            n = heads_[fl][sl];
+            while (n != NIL && nodes_[n].size < needed)
+                n = nodes_[n].nextFree;
+        }
+        if (n == NIL)
+            throw std::out_of_range("No free range large enough");
+        removeFree(n);
+
+        size_t pad = (align - nodes_[n].offset % align) % align;
+        if (pad > 0) {
+            uint32_t front = n;
+            n = split(front, pad);
+            insertFree(front);
+        }
+        if (nodes_[n].size > size)
+            insertFree(split(n, size));
+
+        nodes_[n].free = false;
+        live_.emplace(nodes_[n].offset, n);
+        used_ += size;
+        return nodes_[n].offset;
+    }
+
+    // Deallocates the range starting at offset
+    void deallocate(size_t offset) {
+        auto it = live_.find(offset);
+        if (it == live_.end())
+            throw std::invalid_argument("Offset is not a live allocation");
+        uint32_t n = it->second;
+        live_.erase(it);
+        used_ -= nodes_[n].size;
+        nodes_[n].free = true;
+
+        uint32_t prev = nodes_[n].prevPhys;
+        if (prev != NIL && nodes_[prev].free) {
+            removeFree(prev);
+            n = merge(prev, n);
+        }
+        uint32_t next = nodes_[n].nextPhys;
+        if (next != NIL && nodes_[next].free) {
+            removeFree(next);
+            n = merge(n, next);
+        }
+        insertFree(n);
+    }
+
+    // Size of the live allocation starting at offset
+    size_t sizeOf(size_t offset) const {
+        auto it = live_.find(offset);
+        if (it == live_.end())
+            throw std::invalid_argument("Offset is not a live allocation");
+        return nodes_[it->second].size;
+    }
+
+    size_t capacity() const { return capacity_; }
+    size_t usedSpace() const { return used_; }
+    size_t freeSpace() const { return capacity_ - used_; }
+    size_t liveCount() const { return live_.size(); }
+
+    // Extends the managed range to newCapacity elements. Existing offsets
+    // stay valid; the new space joins the free range at the end, if any.
+    void grow(size_t newCapacity) {
+        if (newCapacity < capacity_)
+            throw std::invalid_argument("Range allocator cannot shrink");
+        if (newCapacity == capacity_)
+            return;
+        size_t extra = newCapacity - capacity_;
+        capacity_ = newCapacity;
+        if (nodes_[tail_].free) {
+            removeFree(tail_);
+            nodes_[tail_].size += extra;
+            insertFree(tail_);
+            return;
+        }
+        uint32_t n = newNode(capacity_ - extra, extra, tail_, NIL);
+        nodes_[tail_].nextPhys = n;
+        tail_ = n;
+        insertFree(n);
+    }
+
+    // Allocates exactly [offset, offset + size), which must lie within one
+    // free range. Walks the ranges, so it is meant for compaction, not hot
+    // paths.
+    void allocateAt(size_t offset, size_t size) {
+        if (size == 0)
+            throw std::invalid_argument("Invalid allocation size");
+        uint32_t n = 0;
+        while (n != NIL && nodes_[n].offset + nodes_[n].size <= offset)
+            n = nodes_[n].nextPhys;
+        if (n == NIL || !nodes_[n].free || offset + size > nodes_[n].offset + nodes_[n].size)
+            throw std::out_of_range("Requested range is not free");
+        removeFree(n);
+
+        if (offset > nodes_[n].offset) {
+            uint32_t front = n;
+            n = split(front, offset - nodes_[front].offset);
+            insertFree(front);
+        }
+        if (nodes_[n].size > size)
+            insertFree(split(n, size));
+
+        nodes_[n].free = false;
+        live_.emplace(offset, n);
+        used_ += size;
+    }
+
+    // Gives up the free space past newCapacity, which must hold no live
+    // allocation.
+    void shrink(size_t newCapacity) {
+        if (newCapacity > capacity_ || newCapacity < liveEnd() || newCapacity == 0)
+            throw std::invalid_argument("Cannot shrink below the last live allocation");
+        if (newCapacity == capacity_)
+            return;
+        removeFree(tail_);
+        nodes_[tail_].size -= capacity_ - newCapacity;
+        capacity_ = newCapacity;
+        if (nodes_[tail_].size > 0) {
+            insertFree(tail_);
+            return;
+        }
+        // The tail range vanished entirely; its predecessor is live.
+        uint32_t gone = tail_;
+        tail_ = nodes_[gone].prevPhys;
+        nodes_[tail_].nextPhys = NIL;
+        spareNodes_.push_back(gone);
+    }
+
+    // One past the last live element, i.e. the smallest capacity that would
+    // still hold every allocation.
+    size_t liveEnd() const {
+        return nodes_[tail_].free ? nodes_[tail_].offset : capacity_;
+    }
+
+    // Calls fn(offset, size) for every free range in offset order.
+    template<class Fn>
+    void forEachFree(Fn&& fn) const {
+        for (uint32_t n = 0; n != NIL; n = nodes_[n].nextPhys)
+            if (nodes_[n].free)
+                fn(nodes_[n].offset, nodes_[n].size);
+    }
+
+    // Calls fn(offset, size) for every live allocation in offset order.
+    template<class Fn>
+    void forEachLive(Fn&& fn) const {
+        for (uint32_t n = 0; n != NIL; n = nodes_[n].nextPhys)
+            if (!nodes_[n].free)
+                fn(nodes_[n].offset, nodes_[n].size);
+    }
+
+    // Largest single range that could currently be allocated. Walks the list
+    // of the highest occupied size class, so it is for stats, not hot paths.
+    size_t largestFree() const {
+        if (flMap_ == 0)
+            return 0;
+        unsigned fl = std::bit_width(flMap_) - 1;
+        unsigned sl = std::bit_width(slMap_[fl]) - 1;
+        size_t best = 0;
+        for (uint32_t n = heads_[fl][sl]; n != NIL; n = nodes_[n].nextFree)
+            best = std::max(best, nodes_[n].size);
+        return best;
+    }
+
+    void reset() {
+        nodes_.clear();
+        spareNodes_.clear();
+        live_.clear();
+        used_ = 0;
+        flMap_ = 0;
+        slMap_.fill(0);
+        for (auto& row : heads_)
+            row.fill(NIL);
+        tail_ = newNode(0, capacity_, NIL, NIL);
+        insertFree(tail_);
+    }
+
+    void print()
+    {
+        std::cout << "Ranges: ";
+        // Node 0 always starts at offset 0: splits and merges keep the front node.
+        for (uint32_t n = 0; n != NIL; n = nodes_[n].nextPhys)
+            std::cout << (nodes_[n].free ? "free " : "used ") << nodes_[n].offset << "+" << nodes_[n].size << " ";
+        std::cout << std::endl;
+    }
+
+private:
+    static constexpr unsigned SL_BITS = 4;
+    static constexpr size_t SL_COUNT = size_t(1) << SL_BITS;
+    static constexpr unsigned FL_COUNT = 64 - SL_BITS + 1;
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Node {
+        size_t offset;
+        size_t size;
+        uint32_t prevPhys, nextPhys;
+        uint32_t prevFree, nextFree;
+        bool free;
+    };
+
+    // Size class of a range: sizes below SL_COUNT each get their own list,
+    // larger ones split each power of two into SL_COUNT equal steps.
+    static void mapping(size_t size, unsigned& fl, unsigned& sl) {
+        if (size < SL_COUNT) {
+            fl = 0;
+            sl = static_cast<unsigned>(size);
+            return;
+        }
+        unsigned msb = std::bit_width(size) - 1;
+        fl = msb - SL_BITS + 1;
+        sl = static_cast<unsigned>((size >> (msb - SL_BITS)) - SL_COUNT);
+    }
+
+    // First free range in class (fl, sl) or any larger one, or NIL
+    uint32_t findSuitable(unsigned fl, unsigned sl) const {
+        if (fl >= FL_COUNT)
+            return NIL;
+        uint32_t slMap = slMap_[fl] & (~uint32_t(0) << sl);
+        if (slMap == 0) {
+            uint64_t flMap = fl + 1 < 64 ? flMap_ & (~uint64_t(0) << (fl + 1)) : 0;
+            if (flMap == 0)
+                return NIL;
+            fl = std::countr_zero(flMap);
+            slMap = slMap_[fl];
+        }
+        sl = std::countr_zero(slMap);
+        return heads_[fl][sl];
+    }
+
+    void insertFree(uint32_t n) {
+        unsigned fl, sl;
+        mapping(nodes_[n].size, fl, sl);
+        Node& node = nodes_[n];
+        node.free = true;
+        node.prevFree = NIL;
+        node.nextFree = heads_[fl][sl];
+        if (node.nextFree != NIL)
+            nodes_[node.nextFree].prevFree = n;
+        heads_[fl][sl] = n;
+        flMap_ |= uint64_t(1) << fl;
+        slMap_[fl] |= uint32_t(1) << sl;
+    }
+
+    void removeFree(uint32_t n) {
+        unsigned fl, sl;
+        mapping(nodes_[n].size, fl, sl);
+        Node& node = nodes_[n];
+        if (node.prevFree != NIL)
+            nodes_[node.prevFree].nextFree = node.nextFree;
+        else
+            heads_[fl][sl] = node.nextFree;
+        if (node.nextFree != NIL)
+            nodes_[node.nextFree].prevFree = node.prevFree;
+
+        if (heads_[fl][sl] == NIL) {
+            slMap_[fl] &= ~(uint32_t(1) << sl);
+            if (slMap_[fl] == 0)
+                flMap_ &= ~(uint64_t(1) << fl);
+        }
+    }
+
+    // Cuts n after its first size elements and returns the node for the rest
+    uint32_t split(uint32_t n, size_t size) {
+        uint32_t rest = newNode(nodes_[n].offset + size, nodes_[n].size - size, n, nodes_[n].nextPhys);
+        if (nodes_[rest].nextPhys != NIL)
+            nodes_[nodes_[rest].nextPhys].prevPhys = rest;
+        nodes_[n].nextPhys = rest;
+        if (tail_ == n)
+            tail_ = rest;
+        nodes_[n].size = size;
+        return rest;
+    }
+
+    // Folds b into the physically preceding a and returns a
+    uint32_t merge(uint32_t a, uint32_t b) {
+        nodes_[a].size += nodes_[b].size;
+        nodes_[a].nextPhys = nodes_[b].nextPhys;
+        if (nodes_[a].nextPhys != NIL)
+            nodes_[nodes_[a].nextPhys].prevPhys = a;
+        if (tail_ == b)
+            tail_ = a;
+        spareNodes_.push_back(b);
+        return a;
+    }
+
+    uint32_t newNode(size_t offset, size_t size, uint32_t prevPhys, uint32_t nextPhys) {
+        Node node{offset, size, prevPhys, nextPhys, NIL, NIL, true};
+        if (!spareNodes_.empty()) {
+            uint32_t n = spareNodes_.back();
+            spareNodes_.pop_back();
+            nodes_[n] = node;
+            return n;
+        }
+        nodes_.push_back(node);
+        return static_cast<uint32_t>(nodes_.size() - 1);
+    }
+
+    size_t capacity_;
+    size_t used_ = 0;
+    uint32_t tail_ = 0;
+    uint64_t flMap_ = 0;
+    std::array<uint32_t, FL_COUNT> slMap_{};
+    std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> heads_;
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> spareNodes_;
+    std::unordered_map<size_t, uint32_t> live_;
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+#include "common.hpp"
+#include "ProcGen.hpp"
+#include "Verts.hpp"
+
+// Vertices a MeshCache entry holds besides the heights: none (as
+// DisplacedPlanet stores them) or P_N_C in some GridLayout.
+enum class CachedVertices : uint8_t { None, PNC };
+
+// Counters for MeshCache lookups; safe to read while workers use the cache.
+struct MeshCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;      // includes stale or damaged entries
+    size_t stores = 0;
+    size_t bytesMapped = 0; // total size of the entries that hit
+};
+
+// A cache entry mapped read-only into memory. The spans point straight into
+// the mapping and stay valid while the entry is alive.
+class CachedPlanetMesh {
+public:
+    CachedPlanetMesh(const CachedPlanetMesh&) = delete;
+    CachedPlanetMesh& operator=(const CachedPlanetMesh&) = delete;
+    ~CachedPlanetMesh();
+
+    std::span<const P_N_C> vertices() const { return m_vertices; }
+    // Empty when the entry was stored without indices (shared topology).
+    std::span<const unsigned int> indices() const { return m_indices; }
+    // PlanetArray::raw() of the generated heights, in heightFormat().
+    std::span<const std::byte> heights() const { return m_heights; }
+    HeightFormat heightFormat() const { return m_height_format; }
+
+private:
+    friend class MeshCache;
+    CachedPlanetMesh() = default;
+
+    void* m_map = nullptr;
+    size_t m_size = 0;
+    std::span<const P_N_C> m_vertices;
+    std::span<const unsigned int> m_indices;
+    std::span<const std::byte> m_heights;
+    HeightFormat m_height_format = HeightFormat::Float;
+};
+
+// Generated planet meshes on disk, one file per key, in a versioned binary
+// layout that is mmap'd and used in place: a fixed header followed by
+// 64-byte aligned height, vertex and index sections. Entries are written to
+// a temporary file and renamed, so concurrent workers never see half an
+// entry.
+class MeshCache {
+public:
+    explicit MeshCache(std::filesystem::path dir);
+
+    // Key of an entry for a planet generated with these parameters, holding
+    // vertices laid out as layout; entries of other layouts or vertex
+    // formats never share a key. layout is ignored for CachedVertices::None.
+    static uint64_t planetKey(unsigned long long seed, int nTheta, int nPhi, double rad,
+                              GridLayout layout, CachedVertices vertices = CachedVertices::PNC);
+
+    // The entry for key, or null on a miss.
+    std::shared_ptr<const CachedPlanetMesh> load(uint64_t key);
+
+    // Writes an entry for key; failures only cost the next launch a miss.
+    void store(uint64_t key, const PlanetArray& heights, std::span<const P_N_C> vertices,
+               std::span<const unsigned int> indices = {});
+
+    MeshCacheStats stats() const;
+
+private:
+    std::filesystem::path entryPath(uint64_t key) const;
+
+    std::filesystem::path m_dir;
+    std::atomic<size_t> m_hits{0};
+    std::atomic<size_t> m_misses{0};
+    std::atomic<size_t> m_stores{0};
+    std::atomic<size_t> m_bytes_mapped{0};
+};
+
+#endif
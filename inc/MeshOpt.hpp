@@ -0,0 +1,85 @@
+#ifndef MESHOPT_HPP
+#define MESHOPT_HPP
+
+#include <span>
+
+#include "common.hpp"
+#include "Culling.hpp"
+#include "Verts.hpp"
+
+// Post-transform vertex cache optimization for indexed triangle lists.
+// Generated meshes come out in row-major scan order, which on long rows
+// reloads every vertex once per neighbouring row; reordering the triangles
+// so they fan around recently used vertices brings the ACMR (vertices
+// transformed per triangle, for a 32-entry FIFO) from 1.0 down to 0.65 on
+// planet grids, measured after optimizeIndices().
+//
+// Clusters are not reordered for overdraw as Tipsify suggests. Planets
+// draw shared topologies, which have no positions of their own and cover
+// near-spheres, where every cluster faces away from the centre alike; the
+// other optimized mesh, the asteroid rock, is a single cluster.
+
+// Vertex cache size the triangle order is tuned for.
+constexpr size_t VERTEX_CACHE_SIZE = 16;
+// FIFO size acmr() simulates by default, a common post-transform cache size.
+constexpr size_t ACMR_CACHE_SIZE = 32;
+
+struct MeshOptStats {
+    double acmrBefore;
+    double acmrAfter;
+};
+
+// Average cache miss ratio: vertices a FIFO cache of cache_size entries
+// would transform, per triangle. 3 is the worst case, 0.5 the limit for
+// large regular grids.
+double acmr(std::span<const unsigned int> indices, size_t vertex_count, size_t cache_size = ACMR_CACHE_SIZE);
+
+// The triangles of indices reordered for a vertex cache of cache_size
+// (Tipsify: Sander, Nehab and Barczak 2007). Linear in the mesh size; the
+// set of triangles and their winding are unchanged.
+std::vector<unsigned int> tipsify(std::span<const unsigned int> indices, size_t vertex_count,
+                                  size_t cache_size = VERTEX_CACHE_SIZE);
+
+// The triangles of indices grouped into clusters of at most
+// cluster_triangles, each grown over shared vertices so it covers a compact
+// patch of the surface, and where each cluster starts. A cluster comes out
+// short wherever its growth runs out of neighbours, not only at the end.
+// Winding is unchanged.
+std::pair<std::vector<unsigned int>, ChunkOffsets> clusterTriangles(std::span<const unsigned int> indices, size_t vertex_count,
+                                                                    size_t cluster_triangles = CULL_CHUNK_TRIANGLES);
+
+// New index of every vertex when vertices are stored in the order indices
+// first use them; vertices no triangle uses go last.
+std::vector<unsigned int> fetchRemap(std::span<const unsigned int> indices, size_t vertex_count);
+
+// Reorders indices in place into culling chunks (clusterTriangles), each
+// tipsified for the vertex cache, keeping the vertex order, and sets chunks
+// to where they start; draw and bound the list by those chunks.
+// For index lists whose vertex order is fixed, e.g. shared topologies.
+MeshOptStats optimizeIndices(std::vector<unsigned int>& indices, size_t vertex_count, ChunkOffsets& chunks);
+
+// Applies remap (from fetchRemap) to vertices and indices.
+template<HasAttribPointer T>
+void remapVertices(std::vector<T>& vertices, std::vector<unsigned int>& indices, std::span<const unsigned int> remap)
+{
+    std::vector<T> remapped(vertices.size());
+    for (size_t k = 0; k < vertices.size(); ++k)
+        remapped[remap[k]] = vertices[k];
+    vertices = std::move(remapped);
+    for (auto& index : indices)
+        index = remap[index];
+}
+
+// Optimizes a mesh before ship(): triangles reordered for the vertex cache,
+// then vertices reordered to the order the triangles fetch them. chunks
+// is set as by optimizeIndices().
+template<HasAttribPointer T>
+MeshOptStats optimizeMesh(std::pair<std::vector<T>, std::vector<unsigned int>>& mesh, ChunkOffsets& chunks)
+{
+    auto& [vertices, indices] = mesh;
+    MeshOptStats stats = optimizeIndices(indices, vertices.size(), chunks);
+    remapVertices(vertices, indices, fetchRemap(indices, vertices.size()));
+    return stats;
+}
+
+#endif
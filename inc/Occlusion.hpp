@@ -0,0 +1,64 @@
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+#include <span>
+
+#include "common.hpp"
+#include "Culling.hpp"
+
+// Resolution of the occlusion buffer main() culls against. Occluders are
+// whole planets, so a coarse buffer loses little.
+constexpr size_t OCCLUSION_WIDTH = 256;
+constexpr size_t OCCLUSION_HEIGHT = 192;
+
+// Low-resolution depth buffer on the CPU. Each frame, the solid cores of
+// planets (Occluder spheres) are rasterized into it, and draw bounds are
+// then tested against it, so bodies hidden behind a planet are not drawn.
+// Depths are view-space distances along the view direction, and only ever
+// err towards "visible": a pixel holds the farthest depth of its occluders
+// anywhere within it, and only pixels they cover entirely are written.
+// Needs no GL context.
+class OcclusionBuffer {
+public:
+    OcclusionBuffer(size_t width = OCCLUSION_WIDTH, size_t height = OCCLUSION_HEIGHT);
+
+    // Clears the buffer for a view; projection must be a symmetric
+    // perspective (glm::perspective).
+    void begin(const glm::mat4& view, const glm::mat4& projection);
+
+    // Draws occluder's sphere into the buffer. Does nothing for a radius of
+    // 0 or when the eye is inside it.
+    void rasterize(const Occluder& occluder);
+
+    // Whether all of sphere is behind what was rasterized since begin().
+    // Spheres crossing the near plane or partly off screen test against
+    // the part on screen only, which the frustum leaves to cull.
+    bool occluded(const BoundingSphere& sphere) const;
+
+    size_t width() const { return m_width; }
+    size_t height() const { return m_height; }
+    // Row-major from the bottom row, INFINITY where nothing was drawn.
+    std::span<const float> depth() const { return m_depth; }
+
+private:
+    struct Rect {
+        size_t x0, y0, x1, y1; // pixels [x0, x1) x [y0, y1)
+    };
+
+    // Pixels a sphere at view-space center with radius may cover; false if
+    // it may reach the near plane.
+    bool screenRect(const glm::vec3& center, float radius, Rect& rect) const;
+
+    size_t m_width;
+    size_t m_height;
+    std::vector<float> m_depth;
+    // Depth at pixel corners of the rows being rasterized.
+    std::vector<float> m_corners;
+    glm::mat4 m_view{1.0f};
+    // x and y scale of the projection, and its near plane distance.
+    float m_scale_x = 1.0f;
+    float m_scale_y = 1.0f;
+    float m_near = 0.0f;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Resolves a requested thread count; 0 means one per hardware thread.
+inline unsigned resolveThreads(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    return threads;
+}
+
+// Splits [0, count) into one contiguous chunk per thread and runs
+// fn(begin, end) on each. Chunk k always covers the same range for a given
+// (count, threads), and with one thread fn runs inline on the caller.
+template <typename Fn>
+void parallelRows(size_t count, unsigned threads, Fn&& fn)
+{
+    threads = static_cast<unsigned>(std::min<size_t>(resolveThreads(threads), std::max<size_t>(count, 1)));
+    if (threads <= 1) {
+        fn(size_t(0), count);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    size_t per = count / threads, extra = count % threads, begin = 0;
+    for (unsigned t = 0; t < threads; t++) {
+        size_t end = begin + per + (t < extra ? 1 : 0);
+        if (t + 1 == threads)
+            fn(begin, end);
+        else
+            workers.emplace_back([&fn, begin, end] { fn(begin, end); });
+        begin = end;
+    }
+    for (auto& w : workers)
+        w.join();
+}
+
+// A fixed set of threads running submitted jobs in FIFO order. Destroying the
+// pool drops jobs that have not started and waits for the running ones.
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads = 0)
+    {
+        threads = resolveThreads(threads);
+        for (unsigned t = 0; t < threads; t++)
+            m_workers.emplace_back([this] { run(); });
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopping = true;
+            m_jobs.clear();
+        }
+        m_wake.notify_all();
+        for (auto& w : m_workers)
+            w.join();
+    }
+
+    void submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_jobs.push_back(std::move(job));
+        }
+        m_wake.notify_one();
+    }
+
+    unsigned threads() const { return static_cast<unsigned>(m_workers.size()); }
+
+private:
+    void run()
+    {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock lock(m_mutex);
+                m_wake.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+                if (m_stopping)
+                    return;
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_stopping = false;
+    std::vector<std::thread> m_workers;
+};
+
+#endif
\ No newline at end of file
@@ -1,19 +1,29 @@
 #ifndef PERLIN_HPP
 #define PERLIN_HPP
 #include "common.hpp"
+#include "Simd.hpp"
 
 // Usage: PerlinNoise pn(seed, repeatX, repeatY); float n = pn.noise(x, y);
+//        pn.noise_n(xs, ys, out, n);  // batched, SIMD where the CPU allows
 
 class PerlinNoise {
 public:
+    // Batched results agree with noise() to within this (absolute). With
+    // power-of-two repeat periods (what FractalNoise uses) they are bit-identical.
+    static constexpr float kBatchTolerance = 1e-5f;
+
     // repeatX, repeatY: periods after which noise wraps in x and y (must be > 0 and <= 256, typically powers of two)
-    explicit PerlinNoise(unsigned int seed, int repeatX = 256, int repeatY = 256)
+    // The permutation is a Fisher-Yates shuffle whose i-th draw is seedHash(seed, i),
+    // so equal seeds always give the same table and construction is thread-safe.
+    explicit PerlinNoise(uint64_t seed, int repeatX = 256, int repeatY = 256)
         : repeatX_(repeatX), repeatY_(repeatY)
     {
         p.resize(256);
         std::iota(p.begin(), p.end(), 0);
-        std::default_random_engine engine(mt_gen());
-        std::shuffle(p.begin(), p.end(), engine);
+        for (int i = 255; i > 0; i--) {
+            int j = static_cast<int>(seedHash(seed, i) % static_cast<uint64_t>(i + 1));
+            std::swap(p[i], p[j]);
+        }
         p.insert(p.end(), p.begin(), p.end());
     }
 
@@ -47,6 +57,12 @@ public:
         return lerp(x1, x2, v);
     }
 
+    // out[k] = noise(xs[k], ys[k]) for k in [0, n)
+    void noise_n(const float* xs, const float* ys, float* out, size_t n) const;
+
+    // out[k] = noise(x, ys[k]); the x lattice lookups are shared by the row.
+    void noise_row(float x, const float* ys, float* out, size_t n) const;
+
     // Set new repeat periods
     void setRepeat(int repeatX, int repeatY) {
         repeatX_ = repeatX;
@@ -54,6 +70,8 @@ public:
     }
 
 private:
+    friend struct PerlinKernels;
+
     std::vector<int> p;
     int repeatX_;
     int repeatY_;
@@ -82,19 +100,18 @@ private:
 
 class FractalNoise {
     public:
-        FractalNoise(unsigned long seed, int nTheta, int nPhi,
+        FractalNoise(uint64_t seed, int nTheta, int nPhi,
                     double initial_freq, int octaves = 10, 
                      double lacunarity = 2.0, double scale0 = 0.5)
             : m_seed(seed), m_nTheta(nTheta), m_nPhi(nPhi),
               m_octaves(octaves), m_initial_freq(initial_freq),
               m_lacunarity(lacunarity), m_scale0(scale0) {
             
-            std::mt19937 rng(m_seed);
             double freq = m_initial_freq;
             
             for (int i = 0; i < m_octaves; i++) {
                 // Generate unique seed for each octave from main seed
-                unsigned long octave_seed = rng();
+                uint64_t octave_seed = seedHash(m_seed, i);
                 // Calculate periods for seamless tiling
                 double periodX = m_nTheta * freq;
                 double periodY = m_nPhi * freq;
@@ -118,9 +135,21 @@ class FractalNoise {
             }
             return result;
         }
+
+        // out[k] = noise(xs[k], ys[k]) for k in [0, n)
+        void noise_n(const float* xs, const float* ys, float* out, size_t n) const;
+        // The same, summing only the first octaves octaves.
+        void noise_n(const float* xs, const float* ys, float* out, size_t n, int octaves) const;
+
+        // out[k] = noise(x, y0 + k * dy), e.g. one PlanetArray row
+        void noise_row(double x, double y0, double dy, float* out, size_t n) const;
+
+        int octaves() const { return m_octaves; }
+        // Frequency of octave i, in cycles per unit of x and y.
+        double frequency(int i) const { return m_initial_freq * std::pow(m_lacunarity, i); }
     
     private:
-        unsigned long m_seed;
+        uint64_t m_seed;
         int m_nTheta;
         int m_nPhi;
         int m_octaves;
@@ -0,0 +1,117 @@
+#ifndef PLANETLOADER_HPP
+#define PLANETLOADER_HPP
+
+#include <deque>
+#include <mutex>
+
+#include "common.hpp"
+#include "Parallel.hpp"
+#include "Sprite.hpp"
+
+// Builds planets off the main thread. enqueue() hands the CPU work (fractal
+// heights and meshing) to a worker; pump(), called once a frame on the GL
+// thread, turns finished work into planets and uploads them under a byte
+// budget. A planet is drawn only once all of it is uploaded, so frames keep
+// coming however many planets are queued.
+//
+// P is the planet type. It provides a Context (what create() needs on the GL
+// thread), the Payload its static generate() builds on a worker, prepare()
+// for work shared between planets (such as index lists) that can also run
+// there, create(), and shipSome()/shipped() for the budgeted upload.
+template<class P>
+class BasicPlanetLoader {
+public:
+    using Context = typename P::Context;
+    using Payload = typename P::Payload;
+
+    explicit BasicPlanetLoader(Context context, unsigned workers = 1)
+        : m_context(std::move(context)), m_pool(workers)
+    {
+        // Leave a core to the render thread and split the rest between jobs.
+        unsigned cores = resolveThreads(0);
+        m_job_threads = std::max(1u, (cores > 1 ? cores - 1 : 1) / m_pool.threads());
+    }
+
+    BasicPlanetLoader(const BasicPlanetLoader&) = delete;
+    BasicPlanetLoader& operator=(const BasicPlanetLoader&) = delete;
+
+    // Lets workers reuse meshes from, and store new ones to, cache.
+    void setCache(std::shared_ptr<MeshCache> cache) { m_cache = cache; }
+
+    // Queues a planet; same parameters as the Planet constructor.
+    void enqueue(const glm::vec3& pos, const glm::vec3& euler_angles, unsigned long long seed,
+                 int nTheta = 1024, int nPhi = 1024, double rad = 32.)
+    {
+        Request request{pos, euler_angles, seed, nTheta, nPhi, rad};
+        m_queued++;
+        m_pool.submit([this, request, cache = m_cache]() {
+            P::prepare(m_context, request.nTheta, request.nPhi);
+            Payload payload = P::generate(request.pos, request.seed, request.nTheta, request.nPhi, request.rad,
+                                          m_job_threads, cache.get());
+            std::lock_guard lock(m_mutex);
+            m_done.emplace_back(request, std::move(payload));
+        });
+    }
+
+    // Uploads at most about byte_budget bytes of finished planets and
+    // returns the bytes used. Call on the GL thread.
+    size_t pump(size_t byte_budget)
+    {
+        // Only the swap holds the lock; creating planets does GL work, and
+        // workers finishing meanwhile should not wait on it.
+        std::vector<std::pair<Request, Payload>> done;
+        {
+            std::lock_guard lock(m_mutex);
+            done.swap(m_done);
+        }
+        for (auto& [request, payload] : done) {
+            m_uploading.push_back(P::create(m_context, request.pos, request.euler_angles, request.seed,
+                std::move(payload), request.nTheta, request.nPhi, request.rad));
+            m_queued--;
+        }
+
+        size_t used = 0;
+        while (!m_uploading.empty() && used < byte_budget) {
+            used += m_uploading.front()->shipSome(byte_budget - used);
+            if (!m_uploading.front()->shipped())
+                break;
+            m_planets.push_back(std::move(m_uploading.front()));
+            m_uploading.pop_front();
+        }
+        return used;
+    }
+
+    // Planets enqueued but not yet fully uploaded.
+    size_t pending() const { return m_queued + m_uploading.size(); }
+
+    // Planets that are fully uploaded and drawn, in completion order.
+    const std::vector<std::unique_ptr<P>>& planets() const { return m_planets; }
+
+private:
+    struct Request {
+        glm::vec3 pos;
+        glm::vec3 euler_angles;
+        unsigned long long seed;
+        int nTheta;
+        int nPhi;
+        double rad;
+    };
+
+    Context m_context;
+    std::shared_ptr<MeshCache> m_cache;
+
+    unsigned m_job_threads = 1;
+    size_t m_queued = 0;
+    std::mutex m_mutex;
+    std::vector<std::pair<Request, Payload>> m_done;
+    std::deque<std::unique_ptr<P>> m_uploading;
+    std::vector<std::unique_ptr<P>> m_planets;
+
+    // Last, so it is destroyed (and its workers joined) before the state
+    // they write to.
+    WorkerPool m_pool;
+};
+
+using PlanetLoader = BasicPlanetLoader<Planet>;
+
+#endif
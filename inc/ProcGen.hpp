@@ -2,34 +2,239 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 
 #include "common.hpp"
 
 #include "Verts.hpp"
 
+class FractalNoise;
+
+// Element type PlanetArray stores its heights in.
+// Quantized16 keeps (height - nominal radius) as int16 over +-quant_range.
+enum class HeightFormat { Float, Double, Quantized16 };
+
+// Vertex/index arrangement of a generated planet mesh. The index list only
+// depends on (layout, nTheta, nPhi), which is what lets planets share it.
+// LatLong has nPhi vertices in every row, poles included. ReducedLatLong
+// collapses each pole to one vertex and gives the rings in between
+// ringColumns() vertices, fewer towards the poles, so vertex spacing stays
+// about the same everywhere (see PlanetArray::reducedGridIndices).
+// SkirtedPatch is an nTheta x nTheta patch followed by its skirt ring (see
+// skirtedPatchIndices).
+enum class GridLayout { LatLong, ReducedLatLong, SkirtedPatch };
+
+// Bumped whenever fractal() or vertices<T>() change what a given seed
+// produces, so cached planets from older builds are regenerated.
+constexpr uint32_t PLANET_GENERATOR_VERSION = 1;
+
+// The noise the biome colors of vertices<T>() are varied by, for renderers
+// that color planets on the GPU from the heights instead.
+struct ShadingNoise {
+    std::vector<int8_t> biome; // per sample, row-major, snorm8
+    std::vector<float> polar;  // per column: offset of the polar ice edge
+};
+
 class PlanetArray {
 public:
     // Constructs a planet grid with nTheta rows (from 0 to pi) and nPhi columns (from 0 to 2pi)
-    PlanetArray(size_t nTheta, size_t nPhi, double rad);
+    PlanetArray(size_t nTheta, size_t nPhi, double rad,
+                HeightFormat format = HeightFormat::Float, double quant_range = 4.0);
 
     // Access element using angular coordinates in radians.
     // theta should be in [0, pi] and phi in [0, 2*pi).
-    double& operator()(double theta, double phi);
+    double operator()(double theta, double phi) const;
+
+    // Access element by grid index.
+    double at(size_t i, size_t j) const;
+    void set(size_t i, size_t j, double h);
+
+    // Row i of the underlying storage; S must match format(). Rows are
+    // 64-byte aligned so a span can be handed straight to a SIMD kernel.
+    template <typename S>
+    std::span<S> row(size_t i) {
+        checkElement<S>();
+        return {reinterpret_cast<S*>(m_data.get() + i * m_stride), nPhi};
+    }
+
+    template <typename S>
+    std::span<const S> row(size_t i) const {
+        checkElement<S>();
+        return {reinterpret_cast<const S*>(m_data.get() + i * m_stride), nPhi};
+    }
+
+    // Row i as float heights. Float storage is returned in place; other
+    // formats are decoded into scratch (which must hold cols() values).
+    std::span<const float> rowHeights(size_t i, float* scratch) const;
+
+    size_t rows() const { return nTheta; }
+    size_t cols() const { return nPhi; }
+    HeightFormat format() const { return m_format; }
+    double nominalRadius() const { return nominal_rad; }
+    // Quantized16 heights are nominalRadius() + quantRange() * q / INT16_MAX.
+    double quantRange() const { return m_quant_step * INT16_MAX; }
+    // Bytes held by the height buffer, including row padding.
+    size_t bytes() const { return nTheta * m_stride; }
 
-    const double& operator()(double theta, double phi) const;
+    // The height buffer as stored, e.g. for caching; assignRaw() restores a
+    // copy of it (bytes() long, same format) along with the seed fractal()
+    // was run with.
+    std::span<const std::byte> raw() const { return {m_data.get(), bytes()}; }
+    void assignRaw(std::span<const std::byte> data, unsigned long long seed);
 
+    // Vertices in layout() order: one per sample, row-major, for LatLong;
+    // ring by ring for ReducedLatLong, whose vertices interpolate the samples
+    // of their row (P_N_C and P_N_C_Packed only). Packed vertex types are
+    // relative to {origin, packExtent()}.
     template <HasAttribPointer T>
-    std::pair<std::vector<T>, std::vector<unsigned int>> mesh();
+    std::vector<T> vertices();
 
+    template <HasAttribPointer T>
+    std::pair<std::vector<T>, std::vector<unsigned int>> mesh() {
+        auto indices = m_layout == GridLayout::ReducedLatLong
+            ? reducedGridIndices(nTheta, nPhi)
+            : gridIndices(nTheta, nPhi, m_threads);
+        return {vertices<T>(), std::move(indices)};
+    }
+
+    // The color noise for the seed fractal() was run with.
+    ShadingNoise shadingNoise() const;
+
+    // Largest distance of any sample from the center. Quantized16 grids
+    // return the bound of the format rather than scanning.
+    double packExtent() const;
+
+    // Index list of a GridLayout::LatLong grid of the given size.
+    static std::vector<unsigned int> gridIndices(size_t nTheta, size_t nPhi, unsigned threads = 1);
+
+    // Index list of a GridLayout::ReducedLatLong grid of the given size:
+    // a fan around each pole and a strip zipping each pair of rings.
+    static std::vector<unsigned int> reducedGridIndices(size_t nTheta, size_t nPhi);
+
+    // Vertices in ring i of a ReducedLatLong grid: 1 at the poles, else
+    // nPhi * sin(theta) rounded up to a multiple of 4 (at least 4).
+    static size_t ringColumns(size_t i, size_t nTheta, size_t nPhi);
+
+    // Vertices of a mesh with this layout and size.
+    static size_t vertexCount(GridLayout layout, size_t nTheta, size_t nPhi);
+
+    // Adds fractal noise to the heights. Everything generated afterwards
+    // (including mesh colors) derives from seed alone, so the same
+    // (seed, dimensions, radius) always gives a bit-identical planet.
     void fractal(unsigned long long seed);
 
+    // Worker threads fractal() and mesh<P_N_C>() split the rows across;
+    // 0 uses every hardware thread. The output is the same for any count.
+    void setThreads(unsigned threads) { m_threads = threads; }
+    unsigned threads() const { return m_threads; }
+
+    // Layout vertices<T>() and mesh<T>() build: LatLong (the default) or
+    // ReducedLatLong. The heights are stored the same way either way.
+    void setLayout(GridLayout layout);
+    GridLayout layout() const { return m_layout; }
+
 private:
+    struct AlignedFree {
+        void operator()(std::byte* p) const { std::free(p); }
+    };
+
     size_t nTheta, nPhi;
-    std::vector<std::vector<double>> data;
     double nominal_rad;
+    HeightFormat m_format;
+    double m_quant_step;
+    size_t m_stride; // bytes per row
+    std::unique_ptr<std::byte[], AlignedFree> m_data;
+    unsigned m_threads = 0;
+    unsigned long long m_seed = 0;
+    GridLayout m_layout = GridLayout::LatLong;
+
+    static size_t elementSize(HeightFormat format);
+
+    template <typename S>
+    void checkElement() const {
+        if (sizeof(S) != elementSize(m_format) || std::is_integral_v<S> != (m_format == HeightFormat::Quantized16))
+            throw std::invalid_argument("Row element type does not match height format");
+    }
+
+    template <typename Emit>
+    void shadeVertices(Emit&& emit);
+
+    // Index of the first vertex of each ReducedLatLong ring, plus the total.
+    static std::vector<size_t> ringOffsets(size_t nTheta, size_t nPhi);
+
+    // Adds delta[0..nPhi) to row i.
+    void addToRow(size_t i, const float* delta);
 
     // Converts an angle value to an index in the range [0, divisions-1].
     static size_t angleToIndex(double angle, double minAngle, double maxAngle, size_t divisions);
 
 
 };
+
+template <> std::vector<SFloat3> PlanetArray::vertices<SFloat3>();
+template <> std::vector<SFloat3T2> PlanetArray::vertices<SFloat3T2>();
+template <> std::vector<P_N_C> PlanetArray::vertices<P_N_C>();
+template <> std::vector<P_N_C_Packed> PlanetArray::vertices<P_N_C_Packed>();
+
+// The surface PlanetArray::fractal() and vertices<P_N_C>() give a seed,
+// evaluated at any direction instead of at the grid samples, for meshes that
+// are not LatLong grids (e.g. cube-sphere patches). Heights are clamped to
+// +-height_range like a Quantized16 PlanetArray's but not quantized. With
+// the grid's octaves, at samples outside the polar caps the two agree to
+// within half a step. Safe to use from several threads at once.
+class PlanetField {
+public:
+    // Octaves added below the grid's, each half the size of the last, for
+    // vertices closer together than the grid's samples.
+    static constexpr int DETAIL_OCTAVES = 6;
+    // An octave is only summed where vertices sample its wavelength at
+    // least this many times.
+    static constexpr double SAMPLES_PER_WAVELENGTH = 4.0;
+    // Angles from each pole, in radians, inside which heights sample the
+    // noise over the direction's projection onto the equator plane instead
+    // of over (theta, phi), and across which they fade between the two.
+    // Near the poles a whole row of samples closes into a tiny ring, which
+    // would fan out into a spike.
+    static constexpr double POLE_CAP_INNER = 0.2;
+    static constexpr double POLE_CAP_OUTER = 0.4;
+
+    // Same parameters as the PlanetArray it stands in for; nTheta and nPhi
+    // set the scale of the noise.
+    PlanetField(unsigned long long seed, size_t nTheta, size_t nPhi, double rad, double height_range = 4.0);
+    ~PlanetField();
+
+    PlanetField(const PlanetField&) = delete;
+    PlanetField& operator=(const PlanetField&) = delete;
+
+    // Shades each unit direction dirs[k] into out[k] (same size) the way
+    // vertices<P_N_C>() shades a sample, relative to the planet center.
+    // Heights sum the octaves that vertices spacing apart resolve.
+    void shade(std::span<const glm::vec3> dirs, std::span<P_N_C> out, double spacing) const;
+
+    // Octaves of height noise resolved by vertices spacing apart, at least
+    // one and at most maxOctaves().
+    int octaves(double spacing) const;
+    int maxOctaves() const;
+
+    double radius() const { return nominal_rad; }
+
+private:
+    size_t nTheta, nPhi;
+    double nominal_rad;
+    double m_height_range;
+    std::unique_ptr<FractalNoise> m_height_noise;
+    std::unique_ptr<FractalNoise> m_color_noise;
+};
+
+// Index list of GridLayout::SkirtedPatch: an n x n row-major grid, then one
+// skirt vertex per border vertex, walking the border from (0, 0) along row 0,
+// down column n - 1, back along row n - 1 and up column 0. The skirt hangs
+// below the border, hiding cracks against coarser or finer neighbours.
+std::vector<unsigned int> skirtedPatchIndices(size_t n);
+
+// Grid vertex under skirt vertex k of an n x n SkirtedPatch.
+size_t skirtBorderVertex(size_t n, size_t k);
@@ -0,0 +1,56 @@
+#ifndef PROGRAMCACHE_HPP
+#define PROGRAMCACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "common.hpp"
+
+// Counters for ProgramCache lookups.
+struct ProgramCacheStats {
+    size_t hits = 0;
+    size_t misses = 0; // includes entries the driver rejected
+    size_t stores = 0;
+};
+
+// Linked shader programs on disk (glGetProgramBinary), one file per key.
+// Keys hash the GLSL sources together with the driver's vendor, renderer
+// and version strings, since binaries only load on the driver that wrote
+// them; a driver update simply misses. Entries are written to a temporary
+// file and renamed. Needs a current GL context from construction on; with
+// a driver that offers no binary formats every load misses and nothing is
+// stored.
+class ProgramCache {
+public:
+    explicit ProgramCache(std::filesystem::path dir);
+
+    // Key of a program linked from these sources on this driver.
+    uint64_t programKey(std::string_view vertex_source, std::string_view fragment_source) const;
+
+    // Loads the entry for key into program (a fresh glCreateProgram name)
+    // and returns whether it is now linked. On false, program can still be
+    // built from source.
+    bool load(GLuint program, uint64_t key);
+
+    // Writes program's binary as key's entry; failures only cost the next
+    // launch a compile. Link the program with
+    // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+    void store(GLuint program, uint64_t key);
+
+    bool enabled() const { return m_enabled; }
+    ProgramCacheStats stats() const { return {m_hits, m_misses, m_stores}; }
+
+private:
+    std::filesystem::path entryPath(uint64_t key) const;
+
+    std::filesystem::path m_dir;
+    uint64_t m_driver_key = 0;
+    bool m_enabled = false;
+    size_t m_hits = 0;
+    size_t m_misses = 0;
+    size_t m_stores = 0;
+};
+
+#endif
@@ -0,0 +1,489 @@
+#ifndef QUADTREEPLANET_HPP
+#define QUADTREEPLANET_HPP
+
+#include <array>
+#include <mutex>
+
+#include "common.hpp"
+#include "Camera.hpp"
+#include "Parallel.hpp"
+#include "Sprite.hpp"
+
+// One patch of a cube-sphere quadtree: cube face, depth, and column/row
+// among the 2^level x 2^level patches of that face.
+struct PatchKey {
+    int face;
+    int level;
+    uint32_t x;
+    uint32_t y;
+};
+
+// Unit direction through point (u, v) in [-1, 1]^2 of a cube face. The cube
+// is spherified (rather than just normalized) so patches of one level stay
+// within ~1.5x of each other in size.
+inline glm::vec3 cubeToSphere(int face, double u, double v)
+{
+    double x, y, z;
+    switch (face) {
+        case 0:  x =  1.0; y =  v;   z = -u;   break; // +X
+        case 1:  x = -1.0; y =  v;   z =  u;   break; // -X
+        case 2:  x =  u;   y =  1.0; z = -v;   break; // +Y
+        case 3:  x =  u;   y = -1.0; z =  v;   break; // -Y
+        case 4:  x =  u;   y =  v;   z =  1.0; break; // +Z
+        default: x = -u;   y =  v;   z = -1.0; break; // -Z
+    }
+    double x2 = x * x, y2 = y * y, z2 = z * z;
+    return glm::vec3(static_cast<float>(x * std::sqrt(1.0 - y2 / 2 - z2 / 2 + y2 * z2 / 3)),
+                     static_cast<float>(y * std::sqrt(1.0 - z2 / 2 - x2 / 2 + z2 * x2 / 3)),
+                     static_cast<float>(z * std::sqrt(1.0 - x2 / 2 - y2 / 2 + x2 * y2 / 3)));
+}
+
+// One quadtree patch on the GPU: a SkirtedPatch mesh in the shared pools,
+// drawn through the planet's draw list while it is part of the cut. Its
+// vertices are around the planet's center, which planet_pos places.
+template<HasAttribPointer V>
+class PlanetPatch : public EntitySprite<V>
+{
+public:
+    PlanetPatch(const glm::vec3& planet_pos, std::shared_ptr<DynVBO<V>> vbo, std::shared_ptr<DynIBO> ibo,
+                std::shared_ptr<SharedTopology> topology, std::vector<V> vertices)
+        : EntitySprite<V>(planet_pos, glm::vec3(0.0f), vbo, ibo)
+    {
+        this->m_vertices = std::move(vertices);
+        this->useTopology(topology);
+    }
+
+    // Patches are built by QuadtreePlanet on its workers.
+    void mesh() override {}
+
+    // Ships the whole mesh and drops the CPU copy; patches never reship.
+    size_t shipAndRelease()
+    {
+        this->ship();
+        size_t bytes = this->m_vertices.size() * sizeof(V);
+        this->m_vertices = {};
+        return bytes;
+    }
+};
+
+// A planet drawn as a cube-sphere: six quadtrees of fixed-size patches that
+// split where a patch's vertex spacing would cover more than pixelError()
+// pixels on screen and merge back when it drops well below. The triangle
+// count then depends on the screen rather than on the distance, and detail
+// goes as deep as maxLevel() near the viewer. Patches sample the same
+// fractal (PlanetField) as the grid planets, with finer octaves as they
+// shrink, are built on a worker, and hide cracks against neighbours of
+// other levels with skirts.
+//
+// A patch only leaves the cut once all four children are on the GPU, and
+// a split patch keeps its own mesh, so merges are immediate and the surface
+// never has holes.
+template<HasAttribPointer V = P_N_C_Packed>
+class QuadtreePlanet
+{
+public:
+    static constexpr bool PACKED = std::is_same_v<V, P_N_C_Packed>;
+    // Vertices along a patch edge.
+    static constexpr size_t PATCH_SIZE = 33;
+    static constexpr int MAX_LEVEL = 12;
+    // Patches being built at once; bounds the work wasted on patches the
+    // camera has moved away from before they arrive.
+    static constexpr size_t MAX_IN_FLIGHT = 16;
+    // Split children are merged once their parent's error falls below this
+    // fraction of pixelError(), so a patch at the threshold does not flicker.
+    static constexpr float MERGE_RATIO = 0.5f;
+
+    QuadtreePlanet(const glm::vec3& pos, unsigned long long seed, std::shared_ptr<DynVBO<V>> vbo, std::shared_ptr<DynIBO> ibo,
+                   std::shared_ptr<TopologyCache> topologies, std::shared_ptr<DrawList> draw_list,
+                   std::shared_ptr<TransformPool> transforms,
+                   int nTheta = 1024, int nPhi = 1024, double rad = 32., unsigned workers = 1)
+        : m_pos(pos), m_rad(rad), m_vbo(vbo), m_ibo(ibo), m_draw_list(draw_list), m_transforms(transforms),
+          m_field(seed, nTheta, nPhi, rad, Planet::HEIGHT_RANGE), m_pool(workers)
+    {
+        if (!m_transforms)
+            throw std::logic_error("Quadtree planets need a transform pool");
+        m_topology = topologies->acquire({PATCH_SIZE, PATCH_SIZE, GridLayout::SkirtedPatch});
+        // Past the level that resolves the finest octave, patches would
+        // only resample it.
+        while (m_max_level > 0 && m_field.octaves(spacing({0, m_max_level - 1, 0, 0})) == m_field.maxOctaves())
+            --m_max_level;
+        for (int face = 0; face < 6; ++face)
+            m_roots[face] = makeNode({face, 0, 0, 0});
+    }
+
+    QuadtreePlanet(const QuadtreePlanet&) = delete;
+    QuadtreePlanet& operator=(const QuadtreePlanet&) = delete;
+
+    // Ships patches built since the last call (at most about byte_budget
+    // bytes), then splits and merges for camera and a viewport of that size
+    // in pixels. Returns the bytes shipped. Call once a frame on the GL
+    // thread.
+    size_t update(const Camera& camera, glm::vec2 viewport, size_t byte_budget)
+    {
+        size_t used = receive(byte_budget);
+
+        View view;
+        view.eye = camera.Position;
+        view.front = camera.Front;
+        float tan_half = std::tan(glm::radians(camera.Zoom) / 2.0f);
+        // Pixels per unit of size at unit distance.
+        view.scale = viewport.y / (2.0f * tan_half);
+        // Half-angle of a cone around the frustum's corners.
+        float aspect = viewport.x / viewport.y;
+        view.half_angle = std::atan(tan_half * std::sqrt(1.0f + aspect * aspect));
+        // Distance to the horizon of the lowest possible surface.
+        float low = static_cast<float>(m_rad - Planet::HEIGHT_RANGE);
+        float eye_dist = glm::length(view.eye - m_pos);
+        view.horizon = std::sqrt(std::max(eye_dist * eye_dist - low * low, 0.0f));
+
+        for (auto& root : m_roots)
+            visit(*root, view);
+
+        if constexpr (DEBUG_LOD) {
+            if (m_shown != m_reported_shown) {
+                std::cout << "Quadtree planet: " << m_shown << " patches, " << drawnTriangles() << " triangles" << std::endl;
+                m_reported_shown = m_shown;
+            }
+        }
+        return used;
+    }
+
+    // Largest on-screen vertex spacing, in pixels, before a patch splits.
+    void setPixelError(float pixels) { m_pixel_error = pixels; }
+    float pixelError() const { return m_pixel_error; }
+    // Deepest level patches split to; no deeper than MAX_LEVEL, or than the
+    // field has octaves for.
+    int maxLevel() const { return m_max_level; }
+
+    // Patches in the cut, i.e. drawn this frame.
+    size_t drawnPatches() const { return m_shown; }
+    size_t drawnTriangles() const { return m_shown * m_topology->numIndices() / 3; }
+    // Patches requested from the worker and not yet shipped.
+    size_t pendingPatches() const { return m_in_flight; }
+
+    // Sphere below the lowest point of the surface; every patch culls
+    // against its horizon, and it occludes other bodies.
+    Occluder core() const { return {m_pos, static_cast<float>(m_rad - Planet::HEIGHT_RANGE)}; }
+
+    // Moves the planet. Patches are built around its center, so only their
+    // model matrices change, including those of patches still being built.
+    void setPosition(const glm::vec3& pos)
+    {
+        m_pos = pos;
+        for (auto& root : m_roots)
+            place(*root);
+    }
+
+private:
+    struct View {
+        glm::vec3 eye;
+        glm::vec3 front;
+        float scale;
+        float half_angle;
+        float horizon;
+    };
+
+    struct Node {
+        PatchKey key;
+        // Bounding sphere relative to the planet center, from the nominal
+        // sphere until the mesh arrives, and the patch's vertex spacing.
+        glm::vec3 center;
+        float radius;
+        float spacing;
+
+        std::unique_ptr<PlanetPatch<V>> patch; // once shipped
+        bool requested = false;
+        bool shown = false;
+        bool split = false;                    // children drawn instead
+        std::array<std::unique_ptr<Node>, 4> children;
+    };
+
+    struct Built {
+        PatchKey key;
+        std::vector<V> vertices;
+        PackedBounds bounds;
+        // Bounding sphere of the surface (without the skirt), relative to
+        // the planet center.
+        glm::vec3 center;
+        float radius;
+    };
+
+    std::unique_ptr<Node> makeNode(const PatchKey& key) const
+    {
+        auto node = std::make_unique<Node>();
+        node->key = key;
+
+        double size = 2.0 / (1u << key.level);
+        double u0 = -1.0 + key.x * size, v0 = -1.0 + key.y * size;
+        node->center = cubeToSphere(key.face, u0 + size / 2, v0 + size / 2) * static_cast<float>(m_rad);
+        float radius = 0.0f;
+        for (int corner = 0; corner < 4; ++corner) {
+            glm::vec3 p = cubeToSphere(key.face, u0 + size * (corner & 1), v0 + size * (corner >> 1)) * static_cast<float>(m_rad);
+            radius = std::max(radius, glm::length(p - node->center));
+        }
+        // The surface strays at most HEIGHT_RANGE from the nominal sphere.
+        node->radius = radius + static_cast<float>(Planet::HEIGHT_RANGE);
+        node->spacing = spacing(key);
+        return node;
+    }
+
+    // Vertex spacing of a patch on the nominal sphere, a little
+    // overestimated: the spherified cube stretches patches by up to ~1.5x.
+    float spacing(const PatchKey& key) const
+    {
+        double face_edge = m_rad * M_PI / 2;
+        return static_cast<float>(1.5 * face_edge / (1u << key.level) / (PATCH_SIZE - 1));
+    }
+
+    // Vertex spacing of node in pixels, seen from the view. Patches that
+    // are certainly off screen or behind the horizon need no detail, so
+    // they report no error and collapse back to coarse patches; the triangle
+    // count then follows what is on screen, in orbit or on the ground.
+    float screenError(const Node& node, const View& view) const
+    {
+        glm::vec3 to = m_pos + node.center - view.eye;
+        float center_dist = glm::length(to);
+        float distance = center_dist - node.radius;
+        if (distance > 0.0f) {
+            float angle = std::acos(std::clamp(glm::dot(to / center_dist, view.front), -1.0f, 1.0f));
+            if (angle - std::asin(node.radius / center_dist) > view.half_angle)
+                return 0.0f;
+            // Farther than any point of the lowest surface that the eye can
+            // see past the horizon.
+            float low = static_cast<float>(m_rad - Planet::HEIGHT_RANGE);
+            float high = glm::length(node.center) + node.radius;
+            if (distance > view.horizon + std::sqrt(std::max(high * high - low * low, 0.0f)))
+                return 0.0f;
+        }
+        return node.spacing * view.scale / std::max(distance, 1e-3f);
+    }
+
+    void visit(Node& node, const View& view)
+    {
+        if (!node.patch) {
+            request(node); // only roots get here before their mesh
+            return;
+        }
+
+        float error = screenError(node, view);
+        if (node.split) {
+            if (error < m_pixel_error * MERGE_RATIO) {
+                merge(node);
+                return;
+            }
+            for (auto& child : node.children)
+                visit(*child, view);
+            return;
+        }
+
+        show(node);
+        if (error <= m_pixel_error || node.key.level >= m_max_level) {
+            // Children prefetched for a split that did not happen.
+            if (node.children[0] && error < m_pixel_error * MERGE_RATIO)
+                node.children = {};
+            return;
+        }
+
+        if (!node.children[0]) {
+            for (uint32_t k = 0; k < 4; ++k)
+                node.children[k] = makeNode({node.key.face, node.key.level + 1, node.key.x * 2 + (k & 1), node.key.y * 2 + (k >> 1)});
+        }
+        bool ready = true;
+        for (auto& child : node.children) {
+            if (!child->patch) {
+                request(*child);
+                ready = false;
+            }
+        }
+        if (ready) {
+            hide(node);
+            node.split = true;
+            for (auto& child : node.children)
+                show(*child);
+        }
+    }
+
+    void merge(Node& node)
+    {
+        for (auto& child : node.children)
+            hideAll(*child);
+        node.children = {};
+        node.split = false;
+        show(node);
+    }
+
+    void hideAll(Node& node)
+    {
+        hide(node);
+        for (auto& child : node.children) {
+            if (child)
+                hideAll(*child);
+        }
+    }
+
+    void show(Node& node)
+    {
+        if (node.shown)
+            return;
+        node.patch->setDrawList(m_draw_list);
+        node.shown = true;
+        m_shown++;
+    }
+
+    void hide(Node& node)
+    {
+        if (!node.shown)
+            return;
+        node.patch->setDrawList(nullptr);
+        node.shown = false;
+        m_shown--;
+    }
+
+    void request(Node& node)
+    {
+        if (node.requested || m_in_flight >= MAX_IN_FLIGHT)
+            return;
+        node.requested = true;
+        m_in_flight++;
+        m_pool.submit([this, key = node.key]() {
+            Built built = build(key);
+            std::lock_guard lock(m_mutex);
+            m_built.push_back(std::move(built));
+        });
+    }
+
+    // Ships finished patches whose nodes still exist.
+    size_t receive(size_t byte_budget)
+    {
+        std::vector<Built> built;
+        {
+            std::lock_guard lock(m_mutex);
+            built.swap(m_built);
+        }
+
+        size_t used = 0;
+        size_t k = 0;
+        for (; k < built.size() && used < byte_budget; ++k) {
+            m_in_flight--;
+            Node* node = find(built[k].key);
+            if (!node || node->patch)
+                continue; // merged away while it was being built
+            node->center = built[k].center;
+            node->radius = built[k].radius;
+            node->patch = std::make_unique<PlanetPatch<V>>(m_pos, m_vbo, m_ibo, m_topology,
+                                                           std::move(built[k].vertices));
+            if constexpr (PACKED)
+                node->patch->setBounds(built[k].bounds);
+            node->patch->setTransforms(m_transforms);
+            node->patch->setCore({glm::vec3(0.0f), core().radius});
+            used += node->patch->shipAndRelease();
+        }
+
+        // Over budget: the rest waits for the next frame.
+        if (k < built.size()) {
+            std::lock_guard lock(m_mutex);
+            m_built.insert(m_built.begin(), std::make_move_iterator(built.begin() + k), std::make_move_iterator(built.end()));
+        }
+        return used;
+    }
+
+    void place(Node& node)
+    {
+        if (node.patch)
+            node.patch->setTransform(m_pos, glm::vec3(0.0f));
+        for (auto& child : node.children) {
+            if (child)
+                place(*child);
+        }
+    }
+
+    Node* find(const PatchKey& key) const
+    {
+        Node* node = m_roots[key.face].get();
+        for (int level = key.level - 1; level >= 0 && node; --level) {
+            uint32_t k = ((key.x >> level) & 1) | (((key.y >> level) & 1) << 1);
+            node = node->children[k].get();
+        }
+        return node;
+    }
+
+    // Builds the mesh of one patch: a PATCH_SIZE^2 grid over the patch's
+    // part of the face, then the skirt ring, hanging two vertex spacings
+    // below the border. Touches no GL state.
+    Built build(const PatchKey& key) const
+    {
+        const size_t n = PATCH_SIZE, ring = 4 * (n - 1);
+        double size = 2.0 / (1u << key.level);
+        double u0 = -1.0 + key.x * size, v0 = -1.0 + key.y * size;
+
+        std::vector<glm::vec3> dirs(n * n + ring);
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j)
+                dirs[i * n + j] = cubeToSphere(key.face, u0 + size * j / (n - 1), v0 + size * i / (n - 1));
+        }
+        for (size_t k = 0; k < ring; ++k)
+            dirs[n * n + k] = dirs[skirtBorderVertex(n, k)];
+
+        std::vector<P_N_C> shaded(dirs.size());
+        m_field.shade(dirs, shaded, spacing(key));
+
+        Built built{key, {}, {}, {}, 0.0f};
+        glm::vec3 lo, hi;
+        std::tie(lo, hi) = extent(std::span(shaded).first(n * n));
+        built.center = (lo + hi) * 0.5f;
+        for (size_t k = 0; k < n * n; ++k)
+            built.radius = std::max(built.radius, glm::length(shaded[k].pos - built.center));
+
+        float depth = 2.0f * spacing(key);
+        for (size_t k = n * n; k < shaded.size(); ++k)
+            shaded[k].pos -= dirs[k] * depth;
+
+        if constexpr (PACKED) {
+            std::tie(lo, hi) = extent(shaded);
+            glm::vec3 half = (hi - lo) * 0.5f;
+            PackedBounds local{lo + half, std::max({half.x, half.y, half.z, 1e-6f})};
+            built.vertices.reserve(shaded.size());
+            for (const auto& v : shaded)
+                built.vertices.emplace_back(v, local);
+            built.bounds = local;
+        } else {
+            built.vertices = std::move(shaded);
+        }
+        return built;
+    }
+
+    static std::pair<glm::vec3, glm::vec3> extent(std::span<const P_N_C> vertices)
+    {
+        glm::vec3 lo = vertices[0].pos, hi = vertices[0].pos;
+        for (const auto& v : vertices) {
+            lo = glm::min(lo, v.pos);
+            hi = glm::max(hi, v.pos);
+        }
+        return {lo, hi};
+    }
+
+    glm::vec3 m_pos;
+    double m_rad;
+    std::shared_ptr<DynVBO<V>> m_vbo;
+    std::shared_ptr<DynIBO> m_ibo;
+    std::shared_ptr<DrawList> m_draw_list;
+    std::shared_ptr<TransformPool> m_transforms;
+    std::shared_ptr<SharedTopology> m_topology;
+    PlanetField m_field;
+    int m_max_level = MAX_LEVEL;
+
+    float m_pixel_error = 6.0f;
+    size_t m_shown = 0;
+    size_t m_reported_shown = 0;
+    size_t m_in_flight = 0;
+    std::array<std::unique_ptr<Node>, 6> m_roots;
+
+    std::mutex m_mutex;
+    std::vector<Built> m_built;
+
+    // Last, so it is destroyed (and its workers joined) before the state
+    // they use.
+    WorkerPool m_pool;
+};
+
+#endif
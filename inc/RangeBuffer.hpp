@@ -0,0 +1,243 @@
+#ifndef RANGEBUFFER_HPP
+#define RANGEBUFFER_HPP
+
+#include <functional>
+#include <optional>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "Memmanage.hpp"
+#include "UploadRing.hpp"
+
+// A GL buffer carved into variable-size ranges by a RangeAllocator. This is
+// the part DynVBO and DynIBO share: on-demand growth, and an incremental
+// compactor that slides live ranges towards the front and gives back the
+// free tail.
+class RangeBuffer {
+public:
+    // Called with the new buffer ID and capacity (in elements) after a resize.
+    using ResizeCallback = std::function<void(GLuint, size_t)>;
+    // Called with the new offset once compact() has moved a range.
+    using MoveCallback = std::function<void(size_t)>;
+
+    RangeBuffer(size_t element_size, size_t capacity)
+        : allocator(std::make_shared<RangeAllocator>(capacity)),
+          m_element_size(element_size), m_min_capacity(capacity)
+    {
+        m_id = createBuffer(capacity);
+    }
+
+    RangeBuffer(const RangeBuffer&) = delete;
+    RangeBuffer& operator=(const RangeBuffer&) = delete;
+
+    virtual ~RangeBuffer() { glDeleteBuffers(1, &m_id); }
+
+    GLuint getID() const { return m_id; }
+    size_t capacity() const { return allocator->capacity(); }
+
+    // Allocates count elements and returns the offset of the first. When no
+    // free range is large enough the buffer grows geometrically first, so
+    // offsets handed out earlier stay valid and resizes stay rare. Ranges
+    // given an on_move callback may later be moved by compact(); the others
+    // stay where they are.
+    size_t allocate(size_t count, MoveCallback on_move = {}) {
+        size_t offset;
+        try {
+            offset = allocator->allocate(count);
+        } catch (const std::out_of_range&) {
+            grow(std::max(allocator->capacity() * 2, allocator->capacity() + count));
+            offset = allocator->allocate(count);
+        }
+        if (on_move)
+            m_movers.emplace(offset, std::move(on_move));
+        m_settled = false;
+        return offset;
+    }
+
+    void deallocate(size_t offset) {
+        if (m_move && m_move->from == offset) {
+            allocator->deallocate(m_move->to);
+            m_move.reset();
+        }
+        m_movers.erase(offset);
+        allocator->deallocate(offset);
+        m_settled = false;
+    }
+
+    void onResize(ResizeCallback callback) {
+        m_resize_callbacks.push_back(std::move(callback));
+    }
+
+    // Routes uploads through ring instead of glBufferSubData; null restores
+    // the synchronous path.
+    void setUploadRing(std::shared_ptr<UploadRing> ring) {
+        m_ring = ring;
+    }
+
+    // Moves to a buffer of new_capacity elements, copying the live ranges
+    // over on the GPU.
+    void grow(size_t new_capacity) {
+        allocator->grow(new_capacity);
+        reallocate(new_capacity);
+        m_settled = false;
+    }
+
+    // Copies at most byte_budget bytes towards compacting the buffer and
+    // returns how many it copied. A range is moved by copying it into a free
+    // range nearer the front, possibly over several calls; its owner keeps
+    // drawing the old copy until the move completes and its MoveCallback
+    // fires. Once nothing can move, a free tail larger than the live data
+    // is released, and later calls are free until ranges come or go.
+    size_t compact(size_t byte_budget) {
+        if (!m_move && m_settled)
+            return 0;
+        size_t budget = std::max<size_t>(1, byte_budget / m_element_size);
+        size_t copied = 0;
+        while (copied < budget) {
+            if (!m_move && !beginMove()) {
+                shrinkToFit();
+                m_settled = true;
+                break;
+            }
+            size_t chunk = std::min(m_move->size - m_move->copied, budget - copied);
+            glBindBuffer(GL_COPY_READ_BUFFER, m_id);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                (m_move->from + m_move->copied) * m_element_size,
+                (m_move->to + m_move->copied) * m_element_size,
+                chunk * m_element_size);
+            m_move->copied += chunk;
+            copied += chunk;
+            if (m_move->copied == m_move->size)
+                finishMove();
+        }
+        return copied * m_element_size;
+    }
+
+    std::shared_ptr<RangeAllocator> allocator;
+
+protected:
+    // Writes count elements from data at offset, through the upload ring
+    // when there is one.
+    void upload(size_t offset, const void* data, size_t count) {
+        if (m_ring) {
+            m_ring->upload(m_id, offset * m_element_size, data, count * m_element_size);
+        } else {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_id);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, offset * m_element_size, count * m_element_size, data);
+        }
+        wrote(offset, count);
+    }
+
+    // Has fill(out, first, n) write elements [first, first + n) of count
+    // straight into the upload ring's mapped memory. Needs an upload ring.
+    template<class Fn>
+    void stream(size_t offset, size_t count, Fn&& fill) {
+        if (!m_ring)
+            throw std::logic_error("Streaming needs an upload ring");
+        size_t element_size = m_element_size;
+        m_ring->stream(m_id, offset * element_size, count * element_size,
+            [&](std::byte* out, size_t first, size_t n) { fill(out, first / element_size, n / element_size); },
+            element_size);
+        wrote(offset, count);
+    }
+
+    // Restarts an in-flight move whose source was just overwritten.
+    void wrote(size_t offset, size_t count) {
+        if (m_move && offset < m_move->from + m_move->size && m_move->from < offset + count)
+            m_move->copied = 0;
+    }
+
+    // Re-establishes bindings that referred to the old buffer after a resize.
+    virtual void rebind() {}
+
+private:
+    struct Move {
+        size_t from;
+        size_t to;
+        size_t size;
+        size_t copied = 0;
+    };
+
+    GLuint createBuffer(size_t capacity) {
+        GLuint id;
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, id);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * m_element_size, nullptr, GL_DYNAMIC_DRAW);
+        return id;
+    }
+
+    void reallocate(size_t new_capacity) {
+        GLuint next = createBuffer(new_capacity);
+        glBindBuffer(GL_COPY_READ_BUFFER, m_id);
+        allocator->forEachLive([&](size_t offset, size_t size) {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                offset * m_element_size, offset * m_element_size, size * m_element_size);
+        });
+        glDeleteBuffers(1, &m_id);
+        m_id = next;
+        rebind();
+
+        for (auto& callback : m_resize_callbacks)
+            callback(m_id, new_capacity);
+    }
+
+    // Picks the movable range nearest the end that fits into a free range
+    // before it, and reserves that free range as its destination.
+    bool beginMove() {
+        std::vector<std::pair<size_t, size_t>> free;
+        allocator->forEachFree([&](size_t offset, size_t size) { free.emplace_back(offset, size); });
+        std::vector<std::pair<size_t, size_t>> live;
+        allocator->forEachLive([&](size_t offset, size_t size) {
+            if (m_movers.contains(offset))
+                live.emplace_back(offset, size);
+        });
+
+        for (auto it = live.rbegin(); it != live.rend(); ++it) {
+            auto [from, size] = *it;
+            for (auto [offset, room] : free) {
+                if (offset > from)
+                    break;
+                if (room >= size) {
+                    allocator->allocateAt(offset, size);
+                    m_move = Move{from, offset, size};
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void finishMove() {
+        Move move = *m_move;
+        m_move.reset();
+
+        auto mover = m_movers.extract(move.from);
+        allocator->deallocate(move.from);
+        mover.key() = move.to;
+        auto& on_move = m_movers.insert(std::move(mover)).position->second;
+        on_move(move.to);
+    }
+
+    // Releases the free tail once it outweighs the live data, keeping
+    // headroom so growth and shrinking do not alternate.
+    void shrinkToFit() {
+        size_t end = allocator->liveEnd();
+        size_t target = std::max(m_min_capacity, end * 2);
+        if (target * 2 > allocator->capacity())
+            return;
+        allocator->shrink(target);
+        reallocate(target);
+    }
+
+    GLuint m_id;
+    size_t m_element_size;
+    size_t m_min_capacity;
+    std::optional<Move> m_move;
+    bool m_settled = false;
+    std::unordered_map<size_t, MoveCallback> m_movers;
+    std::vector<ResizeCallback> m_resize_callbacks;
+    std::shared_ptr<UploadRing> m_ring;
+};
+
+#endif
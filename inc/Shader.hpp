@@ -0,0 +1,243 @@
+#ifndef SHADER_HPP
+#define SHADER_HPP
+
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "common.hpp"
+#include "ProgramCache.hpp"
+
+class Shader {
+public:
+    // A uniform's location, resolved once with uniform() so setters do no
+    // lookups. A uniform the program does not use has location -1, which
+    // GL ignores.
+    struct Uniform {
+        GLint location = -1;
+        explicit operator bool() const { return location >= 0; }
+    };
+
+    // Active uniforms of the default block and active uniform blocks, as
+    // reflected at link time.
+    struct UniformInfo {
+        std::string name; // arrays without their "[0]"
+        GLint location;
+        GLenum type;
+        GLint size;
+    };
+    struct BlockInfo {
+        std::string name;
+        GLuint index;
+        GLint dataSize;
+    };
+
+    // the program ID
+    unsigned int ID;
+
+    // Constructor that builds the shader program from vertex and fragment shader source files.
+    // With a cache, a program linked from the same sources on this driver is
+    // loaded instead of compiled, and a freshly linked one is stored.
+    Shader(const std::string path, ProgramCache* cache = nullptr) {
+        
+        std::string vertexPath = path + "/vertex_shader.glsl";
+        std::string fragmentPath = path + "/frag_shader.glsl";
+        
+        // 1. Retrieve the vertex/fragment source code from file
+
+        std::string vertexCode;
+        std::string fragmentCode;
+        std::ifstream vShaderFile;
+        std::ifstream fShaderFile;
+        
+        // Ensure ifstream objects can throw exceptions:
+        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try {
+            vShaderFile.open(vertexPath);
+            fShaderFile.open(fragmentPath);
+            std::stringstream vShaderStream, fShaderStream;
+            vShaderStream << vShaderFile.rdbuf();
+            fShaderStream << fShaderFile.rdbuf();		
+            vShaderFile.close();
+            fShaderFile.close();
+            vertexCode = vShaderStream.str();
+            fragmentCode = fShaderStream.str();
+        } catch (std::ifstream::failure& e) {
+            std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ\n";
+        }
+        const char* vShaderCode = vertexCode.c_str();
+        const char* fShaderCode = fragmentCode.c_str();
+
+        ID = glCreateProgram();
+        uint64_t key = 0;
+        if (cache) {
+            key = cache->programKey(vertexCode, fragmentCode);
+            if (cache->load(ID, key)) {
+                reflect();
+                return;
+            }
+        }
+        
+        // 2. Compile shaders
+        unsigned int vertex, fragment;
+        // Vertex Shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, nullptr);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        
+        // Fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, nullptr);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+        
+        // 3. Link shaders into a shader program
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        if (cache)
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(ID);
+        bool linked = checkCompileErrors(ID, "PROGRAM");
+        
+        // 4. Delete the shader objects once linked
+        glDetachShader(ID, vertex);
+        glDetachShader(ID, fragment);
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+
+        if (cache && linked)
+            cache->store(ID, key);
+
+        reflect();
+    }
+    
+    // Activate the shader program
+    void bind() { 
+        glUseProgram(ID); 
+    }
+    
+    // Handle of the uniform called name, from the table built at link time.
+    // Resolve handles once, e.g. next to the Shader, not per draw.
+    Uniform uniform(std::string_view name) const {
+        for (const auto& info : m_uniforms) {
+            if (info.name == name)
+                return {info.location};
+        }
+        return {};
+    }
+
+    // Points the uniform block called name at a GL_UNIFORM_BUFFER binding
+    // point; does nothing if the program has no such block.
+    void bindBlock(std::string_view name, GLuint binding) const {
+        for (const auto& block : m_blocks) {
+            if (block.name == name)
+                glUniformBlockBinding(ID, block.index, binding);
+        }
+    }
+
+    const std::vector<UniformInfo>& uniforms() const { return m_uniforms; }
+    const std::vector<BlockInfo>& blocks() const { return m_blocks; }
+
+    // Utility functions for setting uniform variables of the bound program
+    void setBool(Uniform u, bool value) const {
+        glUniform1i(u.location, static_cast<int>(value));
+    }
+
+    void setInt(Uniform u, int value) const {
+        glUniform1i(u.location, value);
+    }
+
+    void setFloat(Uniform u, float value) const {
+        glUniform1f(u.location, value);
+    }
+
+    void setVec3(Uniform u, float x, float y, float z) const {
+        glUniform3f(u.location, x, y, z);
+    }
+
+    void setMat4f(Uniform u, const float* matrix) const {
+        glUniformMatrix4fv(u.location, 1, GL_FALSE, matrix);
+    }
+
+    // By name, for one-off setup; these search the table on every call.
+    void setBool(std::string_view name, bool value) const { setBool(uniform(name), value); }
+    void setInt(std::string_view name, int value) const { setInt(uniform(name), value); }
+    void setFloat(std::string_view name, float value) const { setFloat(uniform(name), value); }
+    void setVec3(std::string_view name, float x, float y, float z) const { setVec3(uniform(name), x, y, z); }
+    void setMat4f(std::string_view name, const float* matrix) const { setMat4f(uniform(name), matrix); }
+
+    ~Shader() {
+        // Delete the shader program
+        glDeleteProgram(ID);
+    }
+
+private:
+    std::vector<UniformInfo> m_uniforms;
+    std::vector<BlockInfo> m_blocks;
+
+    // Fills the uniform and block tables of the linked program.
+    void reflect() {
+        GLint count = 0, max_length = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+        std::vector<char> name(std::max(max_length, 1));
+        for (GLint k = 0; k < count; ++k) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, static_cast<GLuint>(k), static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+            GLint location = glGetUniformLocation(ID, name.data());
+            // Members of uniform blocks have no location.
+            if (location < 0)
+                continue;
+            std::string_view plain(name.data(), length);
+            if (plain.ends_with("[0]"))
+                plain.remove_suffix(3);
+            m_uniforms.push_back({std::string(plain), location, type, size});
+        }
+
+        count = max_length = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+        name.assign(std::max(max_length, 1), '\0');
+        for (GLint k = 0; k < count; ++k) {
+            GLsizei length = 0;
+            GLint data_size = 0;
+            glGetActiveUniformBlockName(ID, static_cast<GLuint>(k), static_cast<GLsizei>(name.size()), &length, name.data());
+            glGetActiveUniformBlockiv(ID, static_cast<GLuint>(k), GL_UNIFORM_BLOCK_DATA_SIZE, &data_size);
+            m_blocks.push_back({std::string(name.data(), length), static_cast<GLuint>(k), data_size});
+        }
+    }
+
+    // Utility function for checking shader compilation/linking errors; returns whether there were none.
+    bool checkCompileErrors(unsigned int shader, const std::string& type) {
+        int success;
+        char infoLog[1024];
+        if (type != "PROGRAM") {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                glGetShaderInfoLog(shader, 1024, nullptr, infoLog);
+                std::cerr << "ERROR::SHADER_COMPILATION_ERROR of type: " 
+                          << type << "\n" << infoLog 
+                          << "\n -- --------------------------------------------------- -- " 
+                          << std::endl;
+            }
+        } else {
+            glGetProgramiv(shader, GL_LINK_STATUS, &success);
+            if (!success) {
+                glGetProgramInfoLog(shader, 1024, nullptr, infoLog);
+                std::cerr << "ERROR::PROGRAM_LINKING_ERROR of type: " 
+                          << type << "\n" << infoLog 
+                          << "\n -- --------------------------------------------------- -- " 
+                          << std::endl;
+            }
+        }
+        return success;
+    }
+};
+
+#endif // SHADER_HPP
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+// Instruction set picked at runtime for the batched kernels (noise, frustum
+// culling, occlusion rasterization).
+enum class SimdLevel { Scalar, SSE41, AVX2 };
+
+// The widest level this CPU runs; detected once.
+inline SimdLevel simdLevel()
+{
+    static const SimdLevel level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return SimdLevel::SSE41;
+        return SimdLevel::Scalar;
+    }();
+    return level;
+}
+
+#endif
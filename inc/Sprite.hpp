@@ -5,11 +5,25 @@
 #include "VBO.hpp"
 #include "IBO.hpp"
 #include <glm/gtc/matrix_transform.hpp>
+#include <optional>
 
 #include "ProcGen.hpp"
+#include "Topology.hpp"
+#include "DrawList.hpp"
+#include "MeshCache.hpp"
+#include "TransformPool.hpp"
 
 class BaseSprite
 {
+    public:
+    // Turns the sprite about its origin, then moves it to m_pos.
+    void make_model_mat()
+    {
+        m_model_matrix = glm::translate(glm::mat4(1.0f), m_pos);
+        m_model_matrix = glm::rotate(m_model_matrix, euler_angles.x, glm::vec3(1.0f, 0.0f, 0.0f));
+        m_model_matrix = glm::rotate(m_model_matrix, euler_angles.y, glm::vec3(0.0f, 1.0f, 0.0f));
+        m_model_matrix = glm::rotate(m_model_matrix, euler_angles.z, glm::vec3(0.0f, 0.0f, 1.0f));
+    }
 
     protected:
     int m_id;
@@ -28,12 +42,55 @@ class EntitySprite : public BaseSprite
 {
 protected:
     std::vector<T> m_vertices;
+    // Set instead of m_vertices when the vertices live elsewhere, e.g. in a
+    // mapped MeshCache entry; m_vertex_owner keeps them alive.
+    std::span<const T> m_mapped_vertices;
+    std::shared_ptr<const void> m_vertex_owner;
     std::vector<unsigned int> m_indices;
     std::shared_ptr<DynVBO<T>> m_vbo;
     std::shared_ptr<DynIBO> m_ibo;
 
-    std::vector<int> m_vbo_blocks;
-    std::vector<int> m_ibo_blocks;
+    // This entity's ranges in m_vbo and m_ibo; empty until shipped.
+    BufferRange m_vbo_range;
+    BufferRange m_ibo_range;
+
+    // Set instead of m_indices when the index list is shared with other
+    // entities.
+    std::shared_ptr<SharedTopology> m_topology;
+
+    // Culling chunks of m_indices, e.g. from optimizeMesh(); empty cuts
+    // them every CULL_CHUNK_INDICES.
+    ChunkOffsets m_chunks;
+
+    // Derived meshes set this when they replace m_indices, so the next ship()
+    // uploads them again.
+    bool m_indices_dirty = true;
+
+    // Vertices uploaded so far by ship()/shipSome(), and whether the whole
+    // mesh made it.
+    size_t m_shipped_vertices = 0;
+    bool m_shipped = false;
+
+    // Where this entity's draws live once shipped, if anywhere.
+    std::shared_ptr<DrawList> m_draw_list;
+    DrawList::Handle m_draw_handle = DrawList::INVALID;
+    // Bounds of each draw (culling chunk) in mesh space, from the last
+    // ship(), and placed by the model matrix.
+    std::vector<ChunkBounds> m_local_chunk_bounds;
+    std::vector<ChunkBounds> m_chunk_bounds;
+    // Set for surfaces around a solid core, such as planets; in mesh space.
+    std::optional<Occluder> m_core;
+
+    // Frame of a packed mesh's positions.
+    PackedBounds m_bounds{glm::vec3(0.0f), 1.0f};
+    // This entity's model matrix (times m_bounds' frame when packed) lives
+    // in this slot of m_transforms; the draws pick it through their
+    // baseInstance. Without a pool, vertices are drawn as they are.
+    std::shared_ptr<TransformPool> m_transforms;
+    TransformPool::Slot m_transform_slot = TransformPool::INVALID;
+    // Copies drawn by each draw; with more than one, they read consecutive
+    // slots from m_transform_slot on. Set before setTransforms().
+    size_t m_instance_count = 1;
 
 public:
     EntitySprite(const glm::vec3& pos, const glm::vec3& euler_angles, std::shared_ptr<DynVBO<T>> vbo, std::shared_ptr<DynIBO> ibo)
@@ -46,130 +103,501 @@ public:
         m_id = BaseSprite::id++;
     }
 
+    // The destructor gives back the buffer ranges and transform slot, and
+    // the buffers' move callbacks hold this, so entities stay where they
+    // were built; keep them behind pointers.
+    EntitySprite(const EntitySprite&) = delete;
+    EntitySprite& operator=(const EntitySprite&) = delete;
+
+    // Uploads the mesh. Vertices go into one contiguous VBO range and are
+    // drawn through a base vertex, so m_indices are uploaded
+    // untouched, and only when they changed; shipping again (e.g. after the
+    // vertices moved) costs just the vertex copy.
     void ship()
     {
+        m_shipped = false;
+        m_shipped_vertices = 0;
+        shipSome(SIZE_MAX);
+    }
+
+    // Continues an upload started by ship() or a previous call, moving at
+    // most about byte_budget bytes of vertices, and returns the bytes used.
+    // The indices go up with the last vertices, and the entity is drawn only
+    // once all of it is on the GPU.
+    size_t shipSome(size_t byte_budget)
+    {
+        if (shipped())
+            return 0;
+
         m_vbo->bind();
         m_ibo->bind();
 
-        while (m_vbo_blocks.size() * m_vbo->allocator->blockSize() < m_vertices.size()) {
-            m_vbo_blocks.push_back(m_vbo->allocator->allocate());
-            // cout << "vbo block allocated: " << m_vbo_blocks.back() << "\n";
-        }
+        std::span<const T> vertices = vertexData();
+        if (m_shipped_vertices == 0)
+            reserve(*m_vbo, m_vbo_range, vertices.size());
+
+        size_t count = std::min(vertices.size() - m_shipped_vertices, std::max<size_t>(1, byte_budget / sizeof(T)));
+        if (count > 0)
+            m_vbo->loadData(vertices.data() + m_shipped_vertices, count, m_vbo_range.offset + m_shipped_vertices);
+        m_shipped_vertices += count;
+        size_t used = count * sizeof(T);
+        if (m_shipped_vertices < vertices.size())
+            return used;
 
-        while (m_ibo_blocks.size() * m_ibo->allocator->blockSize() < m_indices.size()) {
-            m_ibo_blocks.push_back(m_ibo->allocator->allocate());
-            // cout << "ibo block allocated: " << m_ibo_blocks.back() << "\n";
+        if (!m_topology && m_indices_dirty) {
+            reserve(*m_ibo, m_ibo_range, m_indices.size());
+            m_ibo->loadData(m_indices.data(), m_indices.size(), m_ibo_range.offset);
+            m_indices_dirty = false;
+            used += m_indices.size() * sizeof(unsigned int);
         }
+        updateChunkBounds();
+        m_shipped = true;
+        updateDrawCommands();
+        return used;
+    }
 
-        // for (auto& block : m_vbo_blocks) {
-        //     cout << "vbo block; " << block << "\n";
-        // }
-        // for (auto& block : m_ibo_blocks) {
-        //     cout << "ibo block; " << block << "\n";
-        // }
+    // Whether the whole mesh is on the GPU.
+    bool shipped() const { return m_shipped; }
 
-        for (int i = 0; i < m_indices.size(); i++) {
-            int block = m_indices[i] / m_vbo->allocator->blockSize();
-            m_indices[i] = (m_indices[i] % m_vbo->allocator->blockSize()) + m_vbo_blocks[block];
-        }
+    // Gives a packed mesh the frame its vertices are relative to. Takes
+    // effect on the GPU right away and on the culling bounds on the next
+    // ship().
+    void setBounds(const PackedBounds& bounds)
+    {
+        m_bounds = bounds;
+        writeTransform();
+    }
 
-        for (int i = 0; i < m_vbo_blocks.size(); i++) {
-            int block = m_vbo_blocks[i];
-            m_vbo->loadData(m_vertices.data() + i * m_vbo->allocator->blockSize(), 
-                std::min(m_vertices.size() - i * m_vbo->allocator->blockSize(), m_vbo->allocator->blockSize()), 
-                block);
-        }
+    // Draws this entity through a slot of pool holding its model matrix,
+    // so setTransform() can move it without touching the vertices.
+    void setTransforms(std::shared_ptr<TransformPool> pool)
+    {
+        if (m_transforms && m_transform_slot != TransformPool::INVALID)
+            m_transforms->release(m_transform_slot);
+        m_transforms = pool;
+        m_transform_slot = m_transforms ? m_transforms->allocate(m_instance_count) : TransformPool::INVALID;
+        writeTransform();
+        updateDrawCommands();
+    }
 
-        for (int i = 0; i < m_ibo_blocks.size(); i++) {
-            int block = m_ibo_blocks[i];
-            m_ibo->loadData(m_indices.data() + i * m_ibo->allocator->blockSize(),
-                std::min(m_indices.size() - i * m_ibo->allocator->blockSize(), m_ibo->allocator->blockSize()), 
-                block);
-        }
+    // Moves and turns the entity. Only its model matrix is uploaded (with
+    // the next TransformPool::upload()), and its culling bounds follow.
+    void setTransform(const glm::vec3& pos, const glm::vec3& euler_angles)
+    {
+        m_pos = pos;
+        this->euler_angles = euler_angles;
+        make_model_mat();
+        writeTransform();
+        placeChunkBounds();
+        pushChunkBounds();
+    }
+
+    const glm::vec3& position() const { return m_pos; }
+    const glm::mat4& modelMatrix() const { return m_model_matrix; }
+
+    // Marks the mesh as a height field around core, e.g. a planet's terrain
+    // around the sphere below its lowest point. From the next ship() on,
+    // its chunks also cull when all their faces point away from the eye or
+    // when they are past core's horizon.
+    // core is in mesh space; core() gives it in world space.
+    void setCore(const Occluder& core) { m_core = core; }
+    std::optional<Occluder> core() const
+    {
+        if (!m_core)
+            return std::nullopt;
+        return Occluder{glm::vec3(m_model_matrix * glm::vec4(m_core->center, 1.0f)), m_core->radius};
+    }
+
+    // Registers the persistent draw list ship() keeps this entity's
+    // commands in.
+    void setDrawList(std::shared_ptr<DrawList> draw_list)
+    {
+        releaseDrawCommands();
+        m_draw_list = draw_list;
+        updateDrawCommands();
     }
 
     size_t numIndicies()
     {
+        if (m_topology)
+            return m_topology->numIndices();
         return static_cast<size_t>(m_indices.size());
     }
 
-    void make_model_mat()
+    // Appends this entity's draws, one per culling chunk, offset by the
+    // first vertex of its range. Each draws all instances; without a
+    // transform pool there is only the one.
+    void addDrawCommands(std::vector<DrawElementsIndirectCommand>& commands)
     {
-        m_model_matrix = glm::mat4(1.0f);
-        m_model_matrix = glm::rotate(m_model_matrix, euler_angles.x, glm::vec3(1.0f, 0.0f, 0.0f));
-        m_model_matrix = glm::rotate(m_model_matrix, euler_angles.y, glm::vec3(0.0f, 1.0f, 0.0f));
-        m_model_matrix = glm::rotate(m_model_matrix, euler_angles.z, glm::vec3(0.0f, 0.0f, 1.0f));
-        m_model_matrix = glm::translate(m_model_matrix, m_pos);
+        if (m_vbo_range.empty())
+            return;
+
+        GLuint base_instance = 0;
+        GLuint instance_count = 1;
+        if (m_transform_slot != TransformPool::INVALID) {
+            base_instance = static_cast<GLuint>(m_transform_slot);
+            instance_count = static_cast<GLuint>(m_instance_count);
+        }
+        if (m_topology) {
+            m_topology->addDrawCommands(commands, static_cast<GLint>(m_vbo_range.offset), base_instance, instance_count);
+            return;
+        }
+
+        ChunkOffsets chunks = drawChunks();
+        for (size_t k = 0; k + 1 < chunks.size(); ++k) {
+            commands.push_back({
+                static_cast<GLuint>(chunks[k + 1] - chunks[k]),
+                instance_count,
+                static_cast<GLuint>(m_ibo_range.offset + chunks[k]),
+                static_cast<GLint>(m_vbo_range.offset),
+                base_instance
+            });
+        }
+    }
+
+    virtual ~EntitySprite()
+    {
+        releaseDrawCommands();
+        if (m_topology)
+            m_topology->removeListener(this);
+        if (!m_vbo_range.empty())
+            m_vbo->deallocate(m_vbo_range.offset);
+        if (!m_ibo_range.empty())
+            m_ibo->deallocate(m_ibo_range.offset);
+        if (m_transforms && m_transform_slot != TransformPool::INVALID)
+            m_transforms->release(m_transform_slot);
+    }
+
+    // Templated mesh generator, to be specialized in derived classes
+    virtual void mesh() = 0;
+
+protected:
+    // Ships and bounds vertices owned by owner instead of m_vertices,
+    // without copying them.
+    void useVertices(std::span<const T> vertices, std::shared_ptr<const void> owner)
+    {
+        m_vertices = {};
+        m_mapped_vertices = vertices;
+        m_vertex_owner = std::move(owner);
     }
 
-    void addDrawCallData(std::vector<GLsizei>& draw_counts, std::vector<void*>& draw_blocks)
+    std::span<const T> vertexData() const
     {
-        for (int i = 0; i < m_ibo_blocks.size(); ++i) {
-            draw_blocks.push_back((void*)(sizeof(unsigned int) * m_ibo_blocks[i]));
-            draw_counts.push_back(static_cast<GLsizei>(std::min(m_ibo->allocator->blockSize(), m_indices.size() - i * m_ibo->allocator->blockSize())));
+        if (m_vertex_owner)
+            return m_mapped_vertices;
+        return m_vertices;
+    }
+
+    // Draws this entity with a shared index list instead of m_indices, and
+    // follows the list if compaction moves it.
+    void useTopology(std::shared_ptr<SharedTopology> topology)
+    {
+        if (m_topology)
+            m_topology->removeListener(this);
+        m_topology = topology;
+        if (m_topology) {
+            m_topology->addListener(this, [this]() { updateDrawCommands(); });
         }
     }
 
-    ~EntitySprite()
+    // m_chunk_bounds from m_local_chunk_bounds and the model matrix, which
+    // only turns and moves, so radii and cone angles carry over.
+    virtual void placeChunkBounds()
     {
-        for (auto& block : m_vbo_blocks) {
-            m_vbo->allocator->deallocate(block);
+        m_chunk_bounds.resize(m_local_chunk_bounds.size());
+        for (size_t k = 0; k < m_local_chunk_bounds.size(); ++k) {
+            const ChunkBounds& local = m_local_chunk_bounds[k];
+            ChunkBounds& world = m_chunk_bounds[k];
+            world = local;
+            world.sphere.center = glm::vec3(m_model_matrix * glm::vec4(local.sphere.center, 1.0f));
+            world.cone.axis = glm::vec3(m_model_matrix * glm::vec4(local.cone.axis, 0.0f));
+            world.occluder.center = glm::vec3(m_model_matrix * glm::vec4(local.occluder.center, 1.0f));
         }
-        for (auto& block : m_ibo_blocks) {
-            m_ibo->allocator->deallocate(block);
-        }  
     }
 
-    // Templated mesh generator, to be specialized in derived classes
-    virtual void mesh() = 0;
+    // Hands m_chunk_bounds to the draw list.
+    void pushChunkBounds()
+    {
+        if (m_draw_list && m_draw_handle != DrawList::INVALID && m_chunk_bounds.size() == m_draw_list->segmentSize(m_draw_handle))
+            m_draw_list->setBounds(m_draw_handle, m_chunk_bounds);
+    }
+
+    // What the vertex shader reads from this entity's transform slot.
+    virtual void writeTransform()
+    {
+        if (!m_transforms || m_transform_slot == TransformPool::INVALID)
+            return;
+        if constexpr (std::is_same_v<T, P_N_C_Packed>)
+            m_transforms->set(m_transform_slot, m_model_matrix * m_bounds.frame());
+        else
+            m_transforms->set(m_transform_slot, m_model_matrix);
+    }
+
+private:
+    // Rewrites this entity's segment of the draw list, once it is shipped.
+    void updateDrawCommands()
+    {
+        if (!m_draw_list || !m_shipped)
+            return;
+
+        std::vector<DrawElementsIndirectCommand> commands;
+        addDrawCommands(commands);
+        if (m_draw_handle != DrawList::INVALID && m_draw_list->segmentSize(m_draw_handle) < commands.size())
+            releaseDrawCommands();
+        if (m_draw_handle == DrawList::INVALID)
+            m_draw_handle = m_draw_list->allocate(commands.size());
+        std::span<const ChunkBounds> bounds;
+        if (m_chunk_bounds.size() == commands.size())
+            bounds = m_chunk_bounds;
+        m_draw_list->set(m_draw_handle, commands, bounds);
+    }
+
+    // Bounds of each draw chunk, from the vertices its indices use: always a
+    // bounding sphere, and with a core, the cone of its face normals. Without
+    // a CPU copy of the vertices there are none, and the draws are never
+    // culled.
+    void updateChunkBounds()
+    {
+        m_local_chunk_bounds.clear();
+        std::span<const T> vertices = vertexData();
+        if (!vertices.empty()) {
+            std::span<const unsigned int> indices = m_topology ? m_topology->indices() : std::span<const unsigned int>(m_indices);
+            ChunkOffsets chunks = drawChunks();
+            for (size_t k = 0; k + 1 < chunks.size(); ++k) {
+                auto chunk = indices.subspan(chunks[k], chunks[k + 1] - chunks[k]);
+                auto position = [this, vertices](unsigned int v) { return meshPosition(vertices[v]); };
+                ChunkBounds bounds;
+                bounds.sphere = boundingSphere(chunk, position);
+                if (m_core) {
+                    bounds.cone = normalCone(chunk, m_core->center, position);
+                    bounds.occluder = *m_core;
+                }
+                m_local_chunk_bounds.push_back(bounds);
+            }
+        }
+        placeChunkBounds();
+    }
+
+    // Culling chunks of whichever index list this entity draws.
+    ChunkOffsets drawChunks() const
+    {
+        if (m_topology)
+            return m_topology->chunks();
+        return m_chunks.empty() ? uniformChunks(m_indices.size()) : m_chunks;
+    }
+
+    glm::vec3 meshPosition(const T& v) const
+    {
+        if constexpr (std::is_same_v<T, P_N_C_Packed>)
+            return v.position(m_bounds);
+        else if constexpr (requires { { v.pos } -> std::convertible_to<glm::vec3>; })
+            return v.pos;
+        else
+            return glm::vec3(v.x, v.y, v.z);
+    }
+
+    void releaseDrawCommands()
+    {
+        if (m_draw_list && m_draw_handle != DrawList::INVALID)
+            m_draw_list->release(m_draw_handle);
+        m_draw_handle = DrawList::INVALID;
+    }
+
+    // Makes sure range holds at least count elements of buffer, moving to a
+    // new range (and growing the buffer if needed) when the mesh outgrew it.
+    // The range follows along when the buffer's compactor moves it.
+    void reserve(RangeBuffer& buffer, BufferRange& range, size_t count)
+    {
+        count = std::max<size_t>(1, count);
+        if (range.size >= count)
+            return;
+
+        if (!range.empty())
+            buffer.deallocate(range.offset);
+        range = {}; // stays empty if the allocation below throws
+        range = {buffer.allocate(count, [this, &range](size_t to) {
+            range.offset = to;
+            updateDrawCommands();
+        }), count};
+    }
 };
 
-class Planet : public EntitySprite<P_N_C>
+// A procedurally generated planet whose mesh is made of V vertices: P_N_C,
+// or P_N_C_Packed within bounds(), around the planet's center and laid out
+// as L (LatLong or ReducedLatLong). Its model matrix places it.
+template<HasAttribPointer V = P_N_C, GridLayout L = GridLayout::LatLong>
+class BasicPlanet : public EntitySprite<V>
 {
     unsigned long long m_seed;
     int m_nTheta;
     int m_nPhi;
     double m_rad;
+    std::shared_ptr<TopologyCache> m_topologies;
 public:
-    Planet(const glm::vec3& pos, const glm::vec3& euler_angles, std::shared_ptr<DynVBO<P_N_C>> vbo, std::shared_ptr<DynIBO> ibo, unsigned long long seed, int nTheta = 1024, int nPhi = 1024, double rad = 32.)
-        : EntitySprite<P_N_C>(pos, euler_angles, vbo, ibo), m_seed(seed), m_nTheta(nTheta), m_nPhi(nPhi), m_rad(rad)
+    // Heights stay within +-HEIGHT_RANGE of the radius (Quantized16 storage),
+    // which bounds how far a packed vertex can be from the center.
+    static constexpr double HEIGHT_RANGE = 4.0;
+    static constexpr bool PACKED = std::is_same_v<V, P_N_C_Packed>;
+    static constexpr GridLayout LAYOUT = L;
+
+    // What BasicPlanetLoader needs to place planets of this type: the pools
+    // they upload to, the draw list they join and the pool holding their
+    // model matrices.
+    struct Context {
+        std::shared_ptr<DynVBO<V>> vbo;
+        std::shared_ptr<DynIBO> ibo;
+        std::shared_ptr<TopologyCache> topologies;
+        std::shared_ptr<DrawList> draw_list;
+        std::shared_ptr<TransformPool> transforms;
+    };
+    // What generate() builds off the GL thread: new vertices, or the cache
+    // entry holding them when it stores V as it is.
+    struct Payload {
+        std::vector<V> vertices;
+        std::shared_ptr<const CachedPlanetMesh> cached;
+    };
+
+    BasicPlanet(const glm::vec3& pos, const glm::vec3& euler_angles, std::shared_ptr<DynVBO<V>> vbo, std::shared_ptr<DynIBO> ibo,
+                std::shared_ptr<TopologyCache> topologies, unsigned long long seed, int nTheta = 1024, int nPhi = 1024, double rad = 32.)
+        : EntitySprite<V>(pos, euler_angles, vbo, ibo), m_seed(seed), m_nTheta(nTheta), m_nPhi(nPhi), m_rad(rad), m_topologies(topologies)
     {
 
         mesh();
     }
 
-
-    ~Planet()
+    // Wraps vertices already built by generate() with the same parameters,
+    // e.g. on a worker thread, instead of generating them here.
+    BasicPlanet(const glm::vec3& pos, const glm::vec3& euler_angles, std::shared_ptr<DynVBO<V>> vbo, std::shared_ptr<DynIBO> ibo,
+                std::shared_ptr<TopologyCache> topologies, unsigned long long seed, Payload vertices,
+                int nTheta = 1024, int nPhi = 1024, double rad = 32.)
+        : EntitySprite<V>(pos, euler_angles, vbo, ibo), m_seed(seed), m_nTheta(nTheta), m_nPhi(nPhi), m_rad(rad), m_topologies(topologies)
     {
-        for (auto& block : m_vbo_blocks) {
-            m_vbo->allocator->deallocate(block);
-        }
-        for (auto& block : m_ibo_blocks) {
-            m_ibo->allocator->deallocate(block);
-        }
+        take(std::move(vertices));
+        attachTopology();
     }
 
     void mesh()
     {
-        // Generate the mesh for the planet here
-        // This could involve creating vertices and indices based on the planet's geometry
-        // For example, you might create a sphere or a cube to represent the planet
-        
-        // The model_P_N_C takes a glm::Vec3 for position, normal, and color
+        take(generate(this->m_pos, m_seed, m_nTheta, m_nPhi, m_rad));
+        attachTopology();
+    }
+
+    // Frame packed vertices of a planet with radius rad are relative to;
+    // pass it to setBounds() before shipping.
+    static PackedBounds bounds(double rad)
+    {
+        return {glm::vec3(0.0f), static_cast<float>(rad + HEIGHT_RANGE)};
+    }
 
-        auto planet = PlanetArray(m_nTheta, m_nPhi, m_rad);
+    // Builds a planet's vertices around the origin; pos is not baked in, the
+    // model matrix places them. Touches no GL state, so it
+    // can run on any thread; threads is passed on to PlanetArray. With a
+    // cache, a stored mesh for the same parameters is used instead of
+    // generating, and a freshly generated one is stored. The cache always
+    // holds P_N_C in layout L; other vertex types are converted from it. A
+    // DisplacedPlanet's heights-only entry still provides the heights. A hit
+    // on P_N_C is not copied; the planet uploads straight from the mapping.
+    static Payload generate(const glm::vec3& /*pos*/, unsigned long long seed, int nTheta, int nPhi, double rad,
+                            unsigned threads = 0, MeshCache* cache = nullptr)
+    {
+        Payload payload;
+        std::vector<V>& vertices = payload.vertices;
+        uint64_t key = MeshCache::planetKey(seed, nTheta, nPhi, rad, L);
+        auto cached = cache ? cache->load(key) : nullptr;
+        if (cache && !cached)
+            cached = cache->load(MeshCache::planetKey(seed, nTheta, nPhi, rad, L, CachedVertices::None));
+        if (cached && cached->vertices().size() == PlanetArray::vertexCount(L, nTheta, nPhi)) {
+            if constexpr (PACKED)
+                vertices = pack(cached->vertices(), rad);
+            else
+                payload.cached = std::move(cached);
+        } else {
+            auto planet = PlanetArray(nTheta, nPhi, rad, HeightFormat::Quantized16, HEIGHT_RANGE);
+            planet.setThreads(threads);
+            planet.setLayout(L);
     
-        planet.fractal(m_seed);
+            // Entries stored by DisplacedPlanet, or damaged ones, may still
+            // hold the heights.
+            if (cached && cached->heightFormat() == planet.format() && cached->heights().size() == planet.bytes())
+                planet.assignRaw(cached->heights(), seed);
+            else
+                planet.fractal(seed);
     
-        std::tie(m_vertices, m_indices) = planet.mesh<P_N_C>();
+            if (cache) {
+                // Cached meshes are stored around the origin, like the output.
+                std::vector<P_N_C> canonical = planet.vertices<P_N_C>();
+                cache->store(key, planet, canonical);
+                if constexpr (PACKED)
+                    vertices = pack(canonical, rad);
+                else
+                    vertices = std::move(canonical);
+            } else {
+                vertices = planet.vertices<V>();
+            }
+        }
+        return payload;
+    }
 
-        for (auto& v : m_vertices) {
-            v.pos += m_pos; // Offset the vertices by the planet's position
+    // Builds the shared index list of this resolution ahead of create().
+    // Touches no GL state.
+    static void prepare(const Context& context, int nTheta, int nPhi)
+    {
+        context.topologies->prepare({static_cast<size_t>(nTheta), static_cast<size_t>(nPhi), L});
+    }
+
+    // Builds a planet from generate()'s output and hands it its draw list
+    // and transform slot (and bounds, when packed). Call on the GL thread.
+    static std::unique_ptr<BasicPlanet> create(const Context& context, const glm::vec3& pos, const glm::vec3& euler_angles,
+                                               unsigned long long seed, Payload vertices, int nTheta, int nPhi, double rad)
+    {
+        auto planet = std::make_unique<BasicPlanet>(pos, euler_angles, context.vbo, context.ibo, context.topologies,
+                                                    seed, std::move(vertices), nTheta, nPhi, rad);
+        if (!context.transforms)
+            throw std::logic_error("Planets need a transform pool");
+        if constexpr (PACKED)
+            planet->setBounds(bounds(rad));
+        planet->setTransforms(context.transforms);
+        planet->setDrawList(context.draw_list);
+        return planet;
+    }
+
+private:
+    // The cache's P_N_C in the packed format, relative to bounds(rad).
+    static std::vector<V> pack(std::span<const P_N_C> vertices, double rad)
+    {
+        PackedBounds local = bounds(rad);
+        std::vector<V> packed(vertices.size());
+        for (size_t k = 0; k < vertices.size(); ++k)
+            packed[k] = V(vertices[k], local);
+        return packed;
+    }
+
+    void take(Payload payload)
+    {
+        if constexpr (!PACKED) {
+            if (payload.cached) {
+                std::span<const P_N_C> mapped = payload.cached->vertices();
+                this->useVertices(mapped, std::move(payload.cached));
+                return;
+            }
         }
+        this->m_vertices = std::move(payload.vertices);
+    }
 
-        std::cout << m_vertices.size() << " vertices, " << m_indices.size() << " indices\n";
+    void attachTopology()
+    {
+        // Every planet of this resolution draws the same cached index list.
+        this->useTopology(m_topologies->acquire({static_cast<size_t>(m_nTheta), static_cast<size_t>(m_nPhi), L}));
+        // Nothing is drawn below the lowest possible height.
+        this->setCore({glm::vec3(0.0f), static_cast<float>(m_rad - HEIGHT_RANGE)});
+
+        if constexpr (DEBUG_PLANETS)
+            std::cout << this->vertexData().size() << " vertices, " << this->numIndicies() << " shared indices\n";
     }
 };
+
+using Planet = BasicPlanet<P_N_C>;
+using PackedPlanet = BasicPlanet<P_N_C_Packed>;
 #endif
 
 
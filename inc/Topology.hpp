@@ -0,0 +1,203 @@
+#ifndef TOPOLOGY_HPP
+#define TOPOLOGY_HPP
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include "common.hpp"
+#include "IBO.hpp"
+#include "DrawList.hpp"
+#include "ProcGen.hpp"
+#include "MeshOpt.hpp"
+
+struct TopologyKey {
+    size_t nTheta;
+    size_t nPhi;
+    GridLayout layout;
+
+    bool operator<(const TopologyKey& o) const {
+        return std::tie(nTheta, nPhi, layout) < std::tie(o.nTheta, o.nPhi, o.layout);
+    }
+};
+
+// An index list uploaded once into a DynIBO and drawn by any number of meshes
+// with the same topology, each through its own base vertex. The index range
+// goes back to the buffer when the last user drops it. When compaction moves
+// the range, the listeners are told so they can rewrite their draws. A CPU
+// copy of the indices and their culling chunks stays behind for the users'
+// chunk bounds.
+class SharedTopology {
+public:
+    // Without chunks, the list is cut every CULL_CHUNK_INDICES.
+    SharedTopology(DynIBO& ibo, std::vector<unsigned int> indices, ChunkOffsets chunks = {})
+        : m_ibo(ibo), m_count(indices.size()), m_indices(std::move(indices)),
+          m_chunks(chunks.empty() ? uniformChunks(m_count) : std::move(chunks))
+    {
+        m_first = ibo.allocate(m_count, [this](size_t to) {
+            m_first = to;
+            for (auto& [owner, listener] : m_listeners)
+                listener();
+        });
+        ibo.loadData(m_indices.data(), m_count, m_first);
+    }
+
+    SharedTopology(const SharedTopology&) = delete;
+    SharedTopology& operator=(const SharedTopology&) = delete;
+
+    ~SharedTopology()
+    {
+        m_ibo.deallocate(m_first);
+    }
+
+    size_t numIndices() const { return m_count; }
+    std::span<const unsigned int> indices() const { return m_indices; }
+    const ChunkOffsets& chunks() const { return m_chunks; }
+    // Offset of the first index in the DynIBO; changes when compaction
+    // moves the list.
+    size_t firstIndex() const { return m_first; }
+
+    // Registers a callback for when the index range moves, keyed by owner.
+    void addListener(const void* owner, std::function<void()> listener)
+    {
+        m_listeners.emplace_back(owner, std::move(listener));
+    }
+
+    void removeListener(const void* owner)
+    {
+        std::erase_if(m_listeners, [&](const auto& entry) { return entry.first == owner; });
+    }
+
+    // Appends the draws of this index list, one per culling chunk, offset by
+    // base_vertex and reading per-draw attributes at base_instance.
+    void addDrawCommands(std::vector<DrawElementsIndirectCommand>& commands, GLint base_vertex,
+                         GLuint base_instance = 0, GLuint instance_count = 1) const
+    {
+        for (size_t k = 0; k + 1 < m_chunks.size(); ++k) {
+            commands.push_back({
+                static_cast<GLuint>(m_chunks[k + 1] - m_chunks[k]),
+                instance_count,
+                static_cast<GLuint>(m_first + m_chunks[k]),
+                base_vertex,
+                base_instance
+            });
+        }
+    }
+
+private:
+    DynIBO& m_ibo;
+    size_t m_count;
+    std::vector<unsigned int> m_indices;
+    ChunkOffsets m_chunks;
+    size_t m_first;
+    std::vector<std::pair<const void*, std::function<void()>>> m_listeners;
+};
+
+// Hands out one SharedTopology per TopologyKey for a given DynIBO, so N
+// planets of the same resolution hold a single copy of their indices.
+// With optimize set, each index list is reordered for the vertex cache
+// before upload. Only the triangles move: the vertex order is the grid's,
+// which every planet's vertices and gl_VertexID lookups rely on. Building
+// and optimizing a large list takes a while, so loaders prepare() it on
+// their workers and acquire() on the GL thread just uploads it.
+class TopologyCache {
+public:
+    explicit TopologyCache(std::shared_ptr<DynIBO> ibo, bool optimize = true)
+        : m_ibo(ibo), m_optimize(optimize)
+    {}
+
+    // Builds key's index list ahead of acquire(), unless it is already
+    // uploaded. Touches no GL state, so it can run on any thread; callers
+    // preparing the same key share one build.
+    void prepare(const TopologyKey& key)
+    {
+        std::shared_ptr<Prepared> prepared;
+        {
+            std::lock_guard lock(m_mutex);
+            if (auto it = m_entries.find(key); it != m_entries.end() && !it->second.expired())
+                return;
+            auto& slot = m_prepared[key];
+            if (!slot)
+                slot = std::make_shared<Prepared>();
+            prepared = slot;
+        }
+        build(key, *prepared);
+    }
+
+    // The uploaded index list of key, built here unless prepare() already
+    // did (or is doing) so. Call on the GL thread.
+    std::shared_ptr<SharedTopology> acquire(const TopologyKey& key)
+    {
+        std::shared_ptr<Prepared> prepared;
+        {
+            std::lock_guard lock(m_mutex);
+            if (auto existing = m_entries[key].lock())
+                return existing;
+            // Stays listed until the upload is published, so a prepare()
+            // meanwhile finds the finished build instead of starting over.
+            auto& slot = m_prepared[key];
+            if (!slot)
+                slot = std::make_shared<Prepared>();
+            prepared = slot;
+        }
+        build(key, *prepared);
+
+        auto topology = std::make_shared<SharedTopology>(*m_ibo, std::move(prepared->indices), std::move(prepared->chunks));
+        std::lock_guard lock(m_mutex);
+        m_entries[key] = topology;
+        if (auto it = m_prepared.find(key); it != m_prepared.end() && it->second == prepared)
+            m_prepared.erase(it);
+        return topology;
+    }
+
+    // Number of distinct topologies currently uploaded.
+    size_t liveCount() const
+    {
+        std::lock_guard lock(m_mutex);
+        return std::count_if(m_entries.begin(), m_entries.end(),
+            [](const auto& entry) { return !entry.second.expired(); });
+    }
+
+private:
+    // An index list built ahead of its upload.
+    struct Prepared {
+        std::once_flag once;
+        std::vector<unsigned int> indices;
+        ChunkOffsets chunks;
+    };
+
+    void build(const TopologyKey& key, Prepared& prepared) const
+    {
+        std::call_once(prepared.once, [&]() {
+            prepared.indices = generate(key);
+            if (!m_optimize)
+                return;
+            MeshOptStats stats = optimizeIndices(prepared.indices, PlanetArray::vertexCount(key.layout, key.nTheta, key.nPhi),
+                                                 prepared.chunks);
+            if constexpr (DEBUG_MESHOPT) {
+                std::cout << "Topology " << key.nTheta << "x" << key.nPhi << ": ACMR " << stats.acmrBefore
+                          << " -> " << stats.acmrAfter << "\n";
+            }
+        });
+    }
+
+    static std::vector<unsigned int> generate(const TopologyKey& key)
+    {
+        switch (key.layout) {
+            case GridLayout::LatLong: return PlanetArray::gridIndices(key.nTheta, key.nPhi, 0);
+            case GridLayout::ReducedLatLong: return PlanetArray::reducedGridIndices(key.nTheta, key.nPhi);
+            case GridLayout::SkirtedPatch: return skirtedPatchIndices(key.nTheta);
+        }
+        throw std::invalid_argument("Unknown grid layout");
+    }
+
+    std::shared_ptr<DynIBO> m_ibo;
+    bool m_optimize;
+    // Guards both maps; the builds themselves run outside it.
+    mutable std::mutex m_mutex;
+    std::map<TopologyKey, std::weak_ptr<SharedTopology>> m_entries;
+    std::map<TopologyKey, std::shared_ptr<Prepared>> m_prepared;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef TRANSFORMPOOL_HPP
+#define TRANSFORMPOOL_HPP
+
+#include <stdexcept>
+
+#include "common.hpp"
+#include "Verts.hpp"
+
+// Model matrices (and tints) of every drawn entity in one GPU buffer, read
+// per instance as the InstanceTransform attributes: an entity's draws set
+// baseInstance to its first slot, and instanced draws read one slot per
+// instance from there. Entities write their matrix into a CPU copy when
+// they move and upload() sends each run of changed slots once a frame, so
+// moving a body costs 68 bytes instead of re-shipping its vertices, however
+// far apart the moving bodies are. Slot 0 holds the identity for draws that
+// have no slot of their own.
+class TransformPool {
+public:
+    using Slot = size_t;
+    static constexpr Slot INVALID = static_cast<Slot>(-1);
+    // Changed slots at most this many slots apart are sent in one call,
+    // clean ones between them included.
+    static constexpr size_t MERGE_GAP = 4;
+
+    // Must be constructed with the VAO bound, like the vertex pools.
+    explicit TransformPool(size_t capacity = 256)
+        : m_transforms(std::max<size_t>(capacity, 2)), m_sizes(m_transforms.size(), 0), m_is_dirty(m_transforms.size(), 0)
+    {
+        glGenBuffers(1, &m_id);
+        glBindBuffer(GL_ARRAY_BUFFER, m_id);
+        glBufferData(GL_ARRAY_BUFFER, m_transforms.size() * sizeof(InstanceTransform), m_transforms.data(), GL_DYNAMIC_DRAW);
+        m_gpu_capacity = m_transforms.size();
+        bindAttributes();
+        m_sizes[0] = 1;
+        m_end = 1;
+    }
+
+    TransformPool(const TransformPool&) = delete;
+    TransformPool& operator=(const TransformPool&) = delete;
+
+    ~TransformPool() { glDeleteBuffers(1, &m_id); }
+
+    // Reserves count consecutive slots, set to the identity and no tint,
+    // and returns the first.
+    Slot allocate(size_t count = 1)
+    {
+        count = std::max<size_t>(count, 1);
+        Slot first = m_end;
+        auto fit = std::find_if(m_free.begin(), m_free.end(), [&](const Free& f) { return f.size >= count; });
+        if (fit != m_free.end()) {
+            first = fit->first;
+            if (fit->size > count)
+                *fit = {fit->first + count, fit->size - count};
+            else
+                m_free.erase(fit);
+        } else {
+            m_end += count;
+            if (m_end > m_transforms.size()) {
+                size_t capacity = m_transforms.size();
+                while (capacity < m_end)
+                    capacity *= 2;
+                m_transforms.resize(capacity);
+                m_sizes.resize(capacity, 0);
+                m_is_dirty.resize(capacity, 0);
+            }
+        }
+        m_sizes[first] = count;
+        for (Slot k = first; k < first + count; ++k) {
+            m_transforms[k] = InstanceTransform{};
+            markDirty(k);
+        }
+        return first;
+    }
+
+    // Returns the slots allocate() handed out at first. They merge with
+    // free slots either side, and free slots at the end shrink size().
+    void release(Slot first)
+    {
+        if (first == 0 || first >= m_sizes.size() || m_sizes[first] == 0)
+            throw std::invalid_argument("Transform slot not allocated");
+        size_t count = m_sizes[first];
+        m_sizes[first] = 0;
+
+        auto next = std::lower_bound(m_free.begin(), m_free.end(), first, [](const Free& f, Slot slot) { return f.first < slot; });
+        if (next != m_free.end() && first + count == next->first) {
+            count += next->size;
+            next = m_free.erase(next);
+        }
+        if (next != m_free.begin() && std::prev(next)->first + std::prev(next)->size == first) {
+            first = std::prev(next)->first;
+            count += std::prev(next)->size;
+            next = m_free.erase(std::prev(next));
+        }
+        if (first + count == m_end)
+            m_end = first;
+        else
+            m_free.insert(next, {first, count});
+    }
+
+    // Take effect on the next upload().
+    void set(Slot slot, const glm::mat4& model)
+    {
+        m_transforms[slot].model = model;
+        markDirty(slot);
+    }
+
+    // Color the slot's vertex colors are multiplied by, each in [0, 1].
+    void setTint(Slot slot, const glm::vec4& tint)
+    {
+        for (int c = 0; c < 4; ++c)
+            m_transforms[slot].tint[c] = static_cast<uint8_t>(std::lround(std::clamp(tint[c], 0.0f, 1.0f) * 255.0f));
+        markDirty(slot);
+    }
+
+    const glm::mat4& get(Slot slot) const { return m_transforms[slot].model; }
+
+    // Sends the slots changed since the last call to the GPU, one
+    // glBufferSubData per run of them (or reallocates the buffer if the pool
+    // grew), and returns the bytes sent.
+    size_t upload()
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_id);
+        if (m_gpu_capacity < m_transforms.size()) {
+            // Same buffer name, so the VAO's attributes stay pointed at it.
+            glBufferData(GL_ARRAY_BUFFER, m_transforms.size() * sizeof(InstanceTransform), m_transforms.data(), GL_DYNAMIC_DRAW);
+            m_gpu_capacity = m_transforms.size();
+            clearDirty();
+            return m_gpu_capacity * sizeof(InstanceTransform);
+        }
+
+        std::sort(m_dirty.begin(), m_dirty.end());
+        size_t bytes = 0;
+        for (size_t k = 0; k < m_dirty.size();) {
+            Slot begin = m_dirty[k], end = begin + 1;
+            for (++k; k < m_dirty.size() && m_dirty[k] <= end + MERGE_GAP; ++k)
+                end = m_dirty[k] + 1;
+            size_t run = (end - begin) * sizeof(InstanceTransform);
+            glBufferSubData(GL_ARRAY_BUFFER, begin * sizeof(InstanceTransform), run, m_transforms.data() + begin);
+            bytes += run;
+        }
+        clearDirty();
+        return bytes;
+    }
+
+    // Slots up to the last one in use, including slot 0.
+    size_t size() const { return m_end; }
+
+    GLuint getID() const { return m_id; }
+
+    // Points the bound VAO's instance attributes at this pool too, for
+    // VAOs other than the one it was constructed with.
+    void bindAttributes() const
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_id);
+        InstanceTransform dummy;
+        dummy.setAttribPointer();
+    }
+
+private:
+    struct Free {
+        Slot first;
+        size_t size;
+    };
+
+    void markDirty(Slot slot)
+    {
+        if (m_is_dirty[slot])
+            return;
+        m_is_dirty[slot] = 1;
+        m_dirty.push_back(slot);
+    }
+
+    void clearDirty()
+    {
+        for (Slot slot : m_dirty)
+            m_is_dirty[slot] = 0;
+        m_dirty.clear();
+    }
+
+    GLuint m_id;
+    std::vector<InstanceTransform> m_transforms;
+    // Per slot: how many slots allocate() handed out starting there, else 0.
+    std::vector<size_t> m_sizes;
+    std::vector<Free> m_free; // by first slot
+    size_t m_end = 0;
+    size_t m_gpu_capacity = 0;
+    // Slots changed since the last upload(), in the order they changed,
+    // and a flag per slot so each is listed once.
+    std::vector<Slot> m_dirty;
+    std::vector<uint8_t> m_is_dirty;
+};
+
+#endif
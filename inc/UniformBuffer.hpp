@@ -0,0 +1,87 @@
+#ifndef UNIFORMBUFFER_HPP
+#define UNIFORMBUFFER_HPP
+
+#include <cstring>
+#include <span>
+#include <stdexcept>
+
+#include "common.hpp"
+
+// Uniform block binding points. Shaders point their blocks at these with
+// Shader::bindBlock().
+constexpr GLuint FRAME_UNIFORM_BINDING = 0;
+
+// Per-frame uniforms, matching the std140 block
+//   layout(std140) uniform Frame { mat4 MVP; vec4 eye; float theta; };
+struct FrameUniforms {
+    glm::mat4 MVP{1.0f};
+    glm::vec4 eye{0.0f}; // camera position, w unused
+    float theta = 0.0f;
+    float pad[3]{};
+};
+static_assert(sizeof(FrameUniforms) == 96, "FrameUniforms must match the std140 layout of Frame");
+
+// Buffer of count std140 blocks of type T, each at an offset GL accepts for
+// glBindBufferRange. One slot serves per-frame data; per-object data keeps
+// one slot per object, rewritten in a single upload and selected per draw
+// by binding its range, so thousands of objects cost no uniform calls.
+template<typename T>
+class UniformBuffer {
+public:
+    explicit UniformBuffer(size_t count = 1)
+        : m_count(std::max<size_t>(count, 1))
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        m_stride = (sizeof(T) + alignment - 1) / alignment * alignment;
+        m_staging.resize(m_stride * m_count);
+        glGenBuffers(1, &m_id);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+        glBufferData(GL_UNIFORM_BUFFER, m_stride * m_count, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    ~UniformBuffer() { glDeleteBuffers(1, &m_id); }
+
+    // Uploads value into slot with one glBufferSubData.
+    void update(const T& value, size_t slot = 0)
+    {
+        if (slot >= m_count)
+            throw std::out_of_range("Uniform buffer slot out of range");
+        glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+        glBufferSubData(GL_UNIFORM_BUFFER, slot * m_stride, sizeof(T), &value);
+    }
+
+    // Uploads values into slots [first, first + values.size()) with one
+    // glBufferSubData.
+    void update(std::span<const T> values, size_t first = 0)
+    {
+        if (values.empty())
+            return;
+        if (first + values.size() > m_count)
+            throw std::out_of_range("Uniform buffer slot out of range");
+        for (size_t k = 0; k < values.size(); ++k)
+            std::memcpy(m_staging.data() + k * m_stride, &values[k], sizeof(T));
+        glBindBuffer(GL_UNIFORM_BUFFER, m_id);
+        glBufferSubData(GL_UNIFORM_BUFFER, first * m_stride, (values.size() - 1) * m_stride + sizeof(T), m_staging.data());
+    }
+
+    // Makes slot the block bound at binding.
+    void bind(GLuint binding, size_t slot = 0) const
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_id, slot * m_stride, sizeof(T));
+    }
+
+    size_t count() const { return m_count; }
+    GLuint getID() const { return m_id; }
+
+private:
+    GLuint m_id;
+    size_t m_count;
+    size_t m_stride;
+    std::vector<std::byte> m_staging;
+};
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef UPLOADRING_HPP
+#define UPLOADRING_HPP
+
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+
+#include "common.hpp"
+
+// Counters for what went through an UploadRing.
+struct UploadStats {
+    size_t bytes = 0;        // bytes copied into destination buffers
+    size_t copies = 0;       // glCopyBufferSubData calls issued
+    size_t fenceWaits = 0;   // reservations that had to wait for the GPU
+    double fenceWaitMs = 0.0; // time spent in those waits
+};
+
+// Persistently mapped staging memory, used as a ring. Producers write
+// straight into the mapping, the ring issues a GPU-side copy into the
+// destination buffer, and a fence per batch tells when that part of the ring
+// may be written again. Nothing blocks unless the ring wraps onto copies the
+// GPU has not finished, and those waits are counted in stats().
+class UploadRing {
+public:
+    explicit UploadRing(size_t capacity = 64 << 20)
+        : m_capacity(capacity)
+    {
+        if (capacity == 0)
+            throw std::invalid_argument("Upload ring needs a non-zero capacity");
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &m_id);
+        glBindBuffer(GL_COPY_READ_BUFFER, m_id);
+        glBufferStorage(GL_COPY_READ_BUFFER, m_capacity, nullptr, flags);
+        m_mapped = static_cast<std::byte*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, m_capacity, flags));
+        if (!m_mapped)
+            throw std::runtime_error("Could not map the upload ring");
+    }
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    ~UploadRing()
+    {
+        for (auto& batch : m_batches)
+            glDeleteSync(batch.fence);
+        glBindBuffer(GL_COPY_READ_BUFFER, m_id);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glDeleteBuffers(1, &m_id);
+    }
+
+    // Streams bytes bytes into dst_buffer at dst_offset. fill(out, first, n)
+    // writes bytes [first, first + n) of the payload to out, which points
+    // into mapped memory; payloads larger than the ring arrive in several
+    // calls, each a multiple of granularity bytes.
+    template<class Fn>
+    void stream(GLuint dst_buffer, size_t dst_offset, size_t bytes, Fn&& fill, size_t granularity = 1)
+    {
+        size_t max_chunk = (m_capacity / 2) / granularity * granularity;
+        if (max_chunk == 0)
+            throw std::invalid_argument("Upload granularity exceeds the ring");
+
+        glBindBuffer(GL_COPY_READ_BUFFER, m_id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, dst_buffer);
+        for (size_t done = 0; done < bytes; ) {
+            size_t chunk = std::min(bytes - done, max_chunk);
+            size_t offset = reserve(chunk);
+            fill(m_mapped + offset, done, chunk);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, dst_offset + done, chunk);
+            m_stats.bytes += chunk;
+            m_stats.copies++;
+            done += chunk;
+        }
+    }
+
+    // Copies bytes bytes from data into dst_buffer at dst_offset.
+    void upload(GLuint dst_buffer, size_t dst_offset, const void* data, size_t bytes)
+    {
+        stream(dst_buffer, dst_offset, bytes, [&](std::byte* out, size_t first, size_t n) {
+            std::memcpy(out, static_cast<const std::byte*>(data) + first, n);
+        });
+    }
+
+    // Fences everything reserved since the last call; once a frame is enough.
+    void submit()
+    {
+        if (m_head == m_fenced)
+            return;
+        m_batches.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), m_head});
+        m_fenced = m_head;
+    }
+
+    const UploadStats& stats() const { return m_stats; }
+    void resetStats() { m_stats = {}; }
+
+    size_t capacity() const { return m_capacity; }
+
+private:
+    // Ring positions count bytes ever reserved; position % m_capacity is the
+    // offset in the buffer.
+    struct Batch {
+        GLsync fence;
+        uint64_t end;
+    };
+
+    static constexpr size_t ALIGNMENT = 64;
+
+    // Returns the buffer offset of bytes free bytes, waiting for the GPU if
+    // the ring has caught up with copies still in flight.
+    size_t reserve(size_t bytes)
+    {
+        uint64_t start = (m_head + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        // Never straddle the end of the buffer; skip to the start instead.
+        if (start % m_capacity + bytes > m_capacity)
+            start += m_capacity - start % m_capacity;
+
+        retire(false);
+        while (start + bytes - m_tail > m_capacity) {
+            if (m_batches.empty())
+                submit();
+            retire(true);
+        }
+        m_head = start + bytes;
+        return static_cast<size_t>(start % m_capacity);
+    }
+
+    // Frees the ring space of finished batches. With wait set, blocks until
+    // at least the oldest batch is done.
+    void retire(bool wait)
+    {
+        while (!m_batches.empty()) {
+            Batch& batch = m_batches.front();
+            GLenum status = glClientWaitSync(batch.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status == GL_TIMEOUT_EXPIRED && wait) {
+                auto t0 = std::chrono::steady_clock::now();
+                do {
+                    status = glClientWaitSync(batch.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+                } while (status == GL_TIMEOUT_EXPIRED);
+                m_stats.fenceWaits++;
+                m_stats.fenceWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            }
+            if (status == GL_TIMEOUT_EXPIRED)
+                return;
+            glDeleteSync(batch.fence);
+            m_tail = batch.end;
+            m_batches.pop_front();
+            wait = false;
+        }
+    }
+
+    GLuint m_id;
+    std::byte* m_mapped;
+    size_t m_capacity;
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+    uint64_t m_fenced = 0;
+    std::deque<Batch> m_batches;
+    UploadStats m_stats;
+};
+
+#endif
@@ -6,7 +6,7 @@
 #include "common.hpp"
 
 #include "Verts.hpp"
-#include "Memmanage.hpp"
+#include "RangeBuffer.hpp"
 
 template<HasAttribPointer T>
 class VBO {
@@ -42,32 +42,26 @@ private:
 };
 
 template<HasAttribPointer T>
-class DynVBO {
+class DynVBO : public RangeBuffer {
 public:
-    DynVBO(int arr_size, int block_size = -1)
-    : m_arr_size(arr_size+1)
+    DynVBO(int arr_size)
+    : RangeBuffer(sizeof(T), arr_size)
     {
-        glGenBuffers(1, &id);
-        glBindBuffer(GL_ARRAY_BUFFER, id);
-        glBufferData(GL_ARRAY_BUFFER, arr_size * sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        bind();
         T dummy;
         dummy.setAttribPointer(); // Call setAttribPointer to configure the vertex attributes
-        allocator = std::make_shared<BlockAllocator>(arr_size, block_size < 0 ? arr_size : block_size); // Initialize allocator with 0 total indices and block size of 1
-    
-        
+
         if constexpr (DEBUG_VBO) {
-            std::cout << "DynVBO created with ID: " << id << ", Array Size: " << m_arr_size << ", Block Size: " << (block_size < 0 ? arr_size : block_size) << std::endl;
+            std::cout << "DynVBO created with ID: " << getID() << ", Array Size: " << capacity() << std::endl;
         }
     }
 
-    ~DynVBO(){ glDeleteBuffers(1, &id); }
-
     void loadData(const std::vector<T>& data, GLsizeiptr idx = 0){
         if (data.empty()) {
             std::cerr << "Error: Attempting to load empty data into VBO." << std::endl;
             return;
         }
-        if (data.size() >= m_arr_size) {
+        if (data.size() > capacity()) {
             std::cerr << "Error: Data size exceeds VBO capacity." << std::endl;
             return;
         }
@@ -76,43 +70,56 @@ public:
     }
 
     void loadData(const T* data, GLsizeiptr arr_size, GLsizeiptr idx = 0){
-        bind();
-
-        if (idx < 0 || idx >= m_arr_size) {
-            std::cerr << "Index out of bounds: " << idx << " for array size: " << m_arr_size << std::endl;
+        GLsizeiptr size = static_cast<GLsizeiptr>(capacity());
+        if (idx < 0 || idx >= size) {
+            std::cerr << "Index out of bounds: " << idx << " for array size: " << size << std::endl;
             return;
         }
 
-        if (idx + arr_size < 0 || idx + arr_size >= m_arr_size) {
-            std::cerr << "Data exceeds buffer size: " << idx + arr_size << " for array size: " << m_arr_size << std::endl;
+        if (idx + arr_size < 0 || idx + arr_size > size) {
+            std::cerr << "Data exceeds buffer size: " << idx + arr_size << " for array size: " << size << std::endl;
             return;
         }
 
 
         if constexpr (DEBUG_VBO) {
-            std::cout << "Loading data into DynVBO " << id << " at index: " << idx << ", size: " << arr_size << std::endl;
+            std::cout << "Loading data into DynVBO " << getID() << " at index: " << idx << ", size: " << arr_size << std::endl;
         }
 
-        glBufferSubData(GL_ARRAY_BUFFER, idx * sizeof(T), arr_size * sizeof(T), data);
+        upload(idx, data, arr_size);
+    }
+
+    // Has produce(out, first, n) write vertices [first, first + n) of count
+    // straight into mapped staging memory, sparing the copy out of a
+    // std::vector. Needs an upload ring.
+    template<class Fn>
+    void write(size_t idx, size_t count, Fn&& produce) {
+        if (idx + count > capacity())
+            throw std::out_of_range("Vertex write exceeds buffer size");
+        stream(idx, count, [&](std::byte* out, size_t first, size_t n) {
+            produce(reinterpret_cast<T*>(out), first, n);
+        });
     }
 
     void bind() const {
-        glBindBuffer(GL_ARRAY_BUFFER, id);
+        glBindBuffer(GL_ARRAY_BUFFER, getID());
     }
 
     void unbind() const {
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
-    GLuint getID() const {
-        return id;
-    }
-
-    std::shared_ptr<BlockAllocator> allocator;
+protected:
+    // Points the attributes of the bound VAO at the new buffer.
+    void rebind() override {
+        bind();
+        T dummy;
+        dummy.setAttribPointer();
 
-private:
-    GLuint id;
-    GLuint m_arr_size;
+        if constexpr (DEBUG_VBO) {
+            std::cout << "DynVBO resized to ID: " << getID() << ", Array Size: " << capacity() << std::endl;
+        }
+    }
 };
 
 #include "VBO.hpp"
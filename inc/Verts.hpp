@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <cstddef>
+#include <cstdint>
 
 #include "glm/glm.hpp"
 
@@ -49,6 +50,50 @@ public:
     P_N_C();
 };
 
+// Frame a packed mesh's positions are relative to: a vertex sits at
+// center + extent * (its snorm16 position). It reaches the GPU folded into
+// the mesh's InstanceTransform.
+class PackedBounds {
+public:
+    glm::vec3 center;
+    float extent;
+
+    // Matrix taking snorm16 positions (as -1..1) to mesh space.
+    glm::mat4 frame() const;
+};
+
+// Model matrix and tint of one instance of a mesh, read per instance as a
+// mat4 (locations 3-6) and an RGBA8 color factor (location 7) starting at
+// baseInstance. For packed meshes the matrix includes their PackedBounds
+// frame.
+class InstanceTransform {
+public:
+    void setAttribPointer();
+
+    glm::mat4 model{1.0f};
+    uint8_t tint[4] = {255, 255, 255, 255};
+};
+
+// 16-byte counterpart of P_N_C: position as snorm16 within a PackedBounds,
+// normal octahedral-encoded in two snorm16, color as RGBA8.
+class P_N_C_Packed {
+public:
+    void setAttribPointer();
+
+    int16_t pos[4]; // xyz, w is padding
+    int16_t norm[2];
+    uint8_t color[4];
+
+    P_N_C_Packed(const glm::vec3& p, const glm::vec3& n, const glm::vec3& c, const PackedBounds& bounds);
+    P_N_C_Packed(const P_N_C& v, const PackedBounds& bounds);
+    P_N_C_Packed();
+
+    // Decodes back to full precision, e.g. to check the quantization error.
+    P_N_C unpack(const PackedBounds& bounds) const;
+    // Just the position of unpack().
+    glm::vec3 position(const PackedBounds& bounds) const;
+};
+
 class Model_P_N_C {
 public:
     void setAttribPointer();
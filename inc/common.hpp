@@ -13,11 +13,25 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <cstdint>
 
 const float PI = 3.14159265f;
 
-static std::random_device rand_device;
-static std::mt19937 mt_gen(0);
+inline std::random_device rand_device;
+// Shared by every translation unit. Procedural generation does not draw from
+// it; derive seeds with seedHash() instead.
+inline std::mt19937 mt_gen(0);
+
+// Counter-based seed derivation (splitmix64 finalizer). The result is a pure
+// function of (seed, counter), so any stream can be derived from a seed on any
+// thread, in any order, without shared generator state.
+inline uint64_t seedHash(uint64_t seed, uint64_t counter)
+{
+    uint64_t z = seed + (counter + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
 
 using std::vector;
 using std::shared_ptr;
@@ -31,6 +45,16 @@ constexpr bool DEBUG_IBO = false || DEBUG;
 
 constexpr bool DEBUG_VBO = false || DEBUG;
 
+constexpr bool DEBUG_UPLOAD = false || DEBUG;
+
+constexpr bool DEBUG_LOD = false || DEBUG;
+
+constexpr bool DEBUG_CULL = false || DEBUG;
+
+constexpr bool DEBUG_MESHOPT = false || DEBUG;
+
+constexpr bool DEBUG_PLANETS = false || DEBUG;
+
 
 #endif
 
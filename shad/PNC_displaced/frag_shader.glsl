@@ -0,0 +1,7 @@
+#version 330 core
+in vec3 col;
+out vec4 FragColor;
+
+void main() {
+    FragColor = vec4(clamp(col, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,81 @@
+#version 330 core
+// No vertex attributes: the shared LatLong index list is drawn with base
+// vertex 0, so gl_VertexID is grid sample i * uNPhi + j. Position, normal
+// and biome color follow PlanetArray::vertices<P_N_C>().
+layout (location = 3) in mat4 aModel;  // per draw: model matrix
+out vec3 col;
+layout(std140) uniform Frame { // FrameUniforms
+    mat4 MVP;
+    vec4 eye;
+    float theta;
+};
+
+uniform int uNTheta;
+uniform int uNPhi;
+uniform float uHeightBias;  // radius = uHeightBias + uHeightScale * height texel
+uniform float uHeightScale;
+uniform float uNominalRad;
+uniform sampler2D uHeights; // nPhi x nTheta
+uniform sampler2D uBiome;   // nPhi x nTheta, snorm8
+uniform sampler2D uPolar;   // nPhi x 1
+
+const float PI = 3.14159265;
+
+vec3 biomeColor(float height_above_nom, float biome_noise)
+{
+    const float DEEP_OCEAN = 0.0;
+    const float SHALLOW_OCEAN = 0.2;
+    const float BEACH = 0.30;
+    const float GRASSLAND = 0.40;
+    const float FOREST = 0.55;
+    const float MOUNTAIN_BASE = 0.65;
+    const float SNOW_LINE = 0.75;
+
+    if (height_above_nom < DEEP_OCEAN)
+        return vec3(0.0, 0.1, 0.3);
+    if (height_above_nom < SHALLOW_OCEAN) {
+        float t = (height_above_nom - DEEP_OCEAN) / (SHALLOW_OCEAN - DEEP_OCEAN);
+        return mix(vec3(0.0, 0.1, 0.3), vec3(0.2, 0.5, 0.9), t);
+    }
+    if (height_above_nom < BEACH)
+        return vec3(0.96, 0.96, 0.7);
+    if (height_above_nom < GRASSLAND) {
+        float noise = biome_noise * 0.05;
+        return vec3(0.1 + noise, 0.7 + noise, 0.2);
+    }
+    if (height_above_nom < FOREST)
+        return vec3(0.0, 0.3 + biome_noise * 0.02, 0.05);
+    if (height_above_nom < MOUNTAIN_BASE) {
+        float rock_variation = biome_noise * 0.03;
+        return vec3(0.4 + rock_variation, 0.4 + rock_variation, 0.4);
+    }
+    if (height_above_nom < SNOW_LINE) {
+        float t = (height_above_nom - MOUNTAIN_BASE) / (SNOW_LINE - MOUNTAIN_BASE);
+        return mix(vec3(0.5), vec3(1.0), t * 1.5);
+    }
+    return vec3(1.0);
+}
+
+void main() {
+    int i = gl_VertexID / uNPhi;
+    int j = gl_VertexID - i * uNPhi;
+    ivec2 texel = ivec2(j, i);
+
+    float r = uHeightBias + uHeightScale * texelFetch(uHeights, texel, 0).r;
+    float th = PI * float(i) / float(uNTheta - 1);
+    float ph = 2.0 * PI * float(j) / float(uNPhi);
+    vec3 dir = vec3(sin(th) * cos(ph), cos(th), sin(th) * sin(ph));
+    gl_Position = MVP * aModel * vec4(r * dir, 1.0);
+
+    vec3 c = biomeColor(r - uNominalRad, texelFetch(uBiome, texel, 0).r);
+
+    // Polar ice, its edge offset per column by the polar noise.
+    float latitude = float(i) / float(uNTheta - 1);
+    float to_pole = min(latitude, 1.0 - latitude);
+    float polar_band_noisy = 0.18 + texelFetch(uPolar, ivec2(j, 0), 0).r * 0.1;
+    if (to_pole < polar_band_noisy - 0.10)
+        c = vec3(0.8, 0.92, 1.0);
+
+    vec3 normal = normalize(mat3(aModel) * dir);
+    col = c * clamp(dot(normal, vec3(cos(theta), 0.0, sin(theta))), 0.0, 1.0);
+}
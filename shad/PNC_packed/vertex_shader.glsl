@@ -0,0 +1,40 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;    // snorm16, relative to aBounds
+layout (location = 1) in vec2 aNorm;   // snorm16, octahedral
+layout (location = 2) in vec4 aCol;    // unorm8
+layout (location = 3) in mat4 aModel;  // per instance: model matrix times the PackedBounds frame
+layout (location = 7) in vec4 aTint;   // per instance: color factor
+out vec3 col;
+layout(std140) uniform Frame { // FrameUniforms
+    mat4 MVP;
+    vec4 eye;
+    float theta;
+};
+
+float clamp(float a, float b, float c)
+{
+    return min(b, max(a,c));
+}
+
+// Cofactors of the model matrix: its inverse-transpose up to a scale the
+// normalize() drops, so normals stay perpendicular under non-uniform scale
+mat3 normalMatrix(mat4 m)
+{
+    vec3 x = vec3(m[0]), y = vec3(m[1]), z = vec3(m[2]);
+    mat3 cof = mat3(cross(y, z), cross(z, x), cross(x, y));
+    return dot(x, cof[0]) < 0.0 ? -cof : cof;
+}
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main() {
+    gl_Position = MVP * aModel * vec4(aPos, 1.0);
+    vec3 norm = normalize(normalMatrix(aModel) * decodeOctahedral(aNorm));
+    col = aCol.rgb * aTint.rgb * clamp(0.0, 1.0, dot(norm, vec3(cos(theta), 0.0, sin(theta))));
+}
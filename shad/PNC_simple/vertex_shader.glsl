@@ -2,16 +2,31 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNorm;
 layout (location = 2) in vec3 aCol;
+layout (location = 3) in mat4 aModel;  // per instance: model matrix
+layout (location = 7) in vec4 aTint;   // per instance: color factor
 out vec3 col;
-uniform mat4 MVP;
-uniform float theta;
+layout(std140) uniform Frame { // FrameUniforms
+    mat4 MVP;
+    vec4 eye;
+    float theta;
+};
 
 float clamp(float a, float b, float c)
 {
     return min(b, max(a,c));
 }
 
+// Cofactors of the model matrix: its inverse-transpose up to a scale the
+// normalize() drops, so normals stay perpendicular under non-uniform scale
+mat3 normalMatrix(mat4 m)
+{
+    vec3 x = vec3(m[0]), y = vec3(m[1]), z = vec3(m[2]);
+    mat3 cof = mat3(cross(y, z), cross(z, x), cross(x, y));
+    return dot(x, cof[0]) < 0.0 ? -cof : cof;
+}
+
 void main() {
-    gl_Position = MVP * vec4(aPos, 1.0);
-    col = aCol * clamp(0.0, 1.0, dot(aNorm, vec3(cos(theta), 0.0, sin(theta))));
+    gl_Position = MVP * aModel * vec4(aPos, 1.0);
+    vec3 norm = normalize(normalMatrix(aModel) * aNorm);
+    col = aCol * aTint.rgb * clamp(0.0, 1.0, dot(norm, vec3(cos(theta), 0.0, sin(theta))));
 }
\ No newline at end of file
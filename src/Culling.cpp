@@ -0,0 +1,147 @@
+#include "Culling.hpp"
+
+#include <bit>
+#include <immintrin.h>
+
+#include "Simd.hpp"
+
+Frustum::Frustum(const glm::mat4& view_proj)
+{
+    // Rows of the matrix; glm is column-major.
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; ++i)
+        row[i] = glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+
+    planes[0] = row[3] + row[0]; // left
+    planes[1] = row[3] - row[0]; // right
+    planes[2] = row[3] + row[1]; // bottom
+    planes[3] = row[3] - row[1]; // top
+    planes[4] = row[3] + row[2]; // near
+    planes[5] = row[3] - row[2]; // far
+    for (auto& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const
+{
+    for (const auto& plane : planes) {
+        if (glm::dot(glm::vec3(plane), sphere.center) + plane.w <= -sphere.radius)
+            return false;
+    }
+    return true;
+}
+
+ChunkOffsets uniformChunks(size_t index_count)
+{
+    ChunkOffsets chunks;
+    for (size_t first = 0; first < index_count; first += CULL_CHUNK_INDICES)
+        chunks.push_back(first);
+    chunks.push_back(index_count);
+    return chunks;
+}
+
+bool facesAway(const NormalCone& cone, const BoundingSphere& sphere, const glm::vec3& eye)
+{
+    glm::vec3 to = sphere.center - eye;
+    return glm::dot(to, cone.axis) >= cone.cutoff * glm::length(to) + sphere.radius;
+}
+
+bool beyondHorizon(const Occluder& occluder, const BoundingSphere& sphere, const glm::vec3& eye)
+{
+    float eye_dist = glm::length(eye - occluder.center);
+    if (occluder.radius <= 0.0f || eye_dist <= occluder.radius)
+        return false;
+    // The farthest a point no higher than high above the occluder's center
+    // can be from the eye and still be seen: both tangent lengths added up.
+    float horizon = std::sqrt(eye_dist * eye_dist - occluder.radius * occluder.radius);
+    float high = glm::length(sphere.center - occluder.center) + sphere.radius;
+    float reach = horizon + std::sqrt(std::max(high * high - occluder.radius * occluder.radius, 0.0f));
+    return glm::length(sphere.center - eye) - sphere.radius > reach;
+}
+
+namespace {
+
+size_t cullScalar(const Frustum& frustum, const float* x, const float* y, const float* z, const float* r,
+                  uint8_t* visible, size_t n)
+{
+    size_t count = 0;
+    for (size_t k = 0; k < n; ++k) {
+        visible[k] = frustum.intersects({glm::vec3(x[k], y[k], z[k]), r[k]});
+        count += visible[k];
+    }
+    return count;
+}
+
+__attribute__((target("avx2")))
+size_t cullAVX2(const Frustum& frustum, const float* x, const float* y, const float* z, const float* r,
+                uint8_t* visible, size_t n)
+{
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm256_set1_ps(frustum.planes[p].x);
+        py[p] = _mm256_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    size_t count = 0, k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256 sx = _mm256_loadu_ps(x + k), sy = _mm256_loadu_ps(y + k), sz = _mm256_loadu_ps(z + k);
+        __m256 neg_r = _mm256_xor_ps(_mm256_loadu_ps(r + k), sign);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], sx), _mm256_mul_ps(py[p], sy)),
+                                     _mm256_add_ps(_mm256_mul_ps(pz[p], sz), pw[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, neg_r, _CMP_GT_OQ));
+        }
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(inside));
+        for (int i = 0; i < 8; ++i)
+            visible[k + i] = (mask >> i) & 1;
+        count += std::popcount(mask);
+    }
+    return count + cullScalar(frustum, x + k, y + k, z + k, r + k, visible + k, n - k);
+}
+
+__attribute__((target("sse4.1")))
+size_t cullSSE41(const Frustum& frustum, const float* x, const float* y, const float* z, const float* r,
+                 uint8_t* visible, size_t n)
+{
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm_set1_ps(frustum.planes[p].x);
+        py[p] = _mm_set1_ps(frustum.planes[p].y);
+        pz[p] = _mm_set1_ps(frustum.planes[p].z);
+        pw[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+    const __m128 sign = _mm_set1_ps(-0.0f);
+
+    size_t count = 0, k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m128 sx = _mm_loadu_ps(x + k), sy = _mm_loadu_ps(y + k), sz = _mm_loadu_ps(z + k);
+        __m128 neg_r = _mm_xor_ps(_mm_loadu_ps(r + k), sign);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], sx), _mm_mul_ps(py[p], sy)),
+                                  _mm_add_ps(_mm_mul_ps(pz[p], sz), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(d, neg_r));
+        }
+        unsigned mask = static_cast<unsigned>(_mm_movemask_ps(inside));
+        for (int i = 0; i < 4; ++i)
+            visible[k + i] = (mask >> i) & 1;
+        count += std::popcount(mask);
+    }
+    return count + cullScalar(frustum, x + k, y + k, z + k, r + k, visible + k, n - k);
+}
+
+} // namespace
+
+size_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* r,
+                   uint8_t* visible, size_t n)
+{
+    switch (simdLevel()) {
+        case SimdLevel::AVX2:  return cullAVX2(frustum, x, y, z, r, visible, n);
+        case SimdLevel::SSE41: return cullSSE41(frustum, x, y, z, r, visible, n);
+        default:               return cullScalar(frustum, x, y, z, r, visible, n);
+    }
+}
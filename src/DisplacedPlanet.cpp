@@ -0,0 +1,221 @@
+#include "DisplacedPlanet.hpp"
+
+namespace {
+
+GLuint createGridTexture(GLenum internal_format, GLenum format, GLenum type, size_t width, size_t height)
+{
+    GLuint id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    // Read with texelFetch only: one level, no filtering.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0,
+                 format, type, nullptr);
+    return id;
+}
+
+// Writes rows [first, first + count) of a texture from data, whose rows are
+// row_length texels apart.
+void uploadRows(GLuint id, size_t width, size_t first, size_t count, size_t row_length,
+                GLenum format, GLenum type, const void* data)
+{
+    glBindTexture(GL_TEXTURE_2D, id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(row_length));
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, static_cast<GLint>(first), static_cast<GLsizei>(width),
+                    static_cast<GLsizei>(count), format, type, data);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+} // namespace
+
+DisplacedPlanet::DisplacedPlanet(const glm::vec3& pos, const glm::vec3& euler_angles, std::shared_ptr<TopologyCache> topologies,
+                                 PlanetSurface surface, int nTheta, int nPhi, double rad)
+    : m_nTheta(nTheta), m_nPhi(nPhi), m_rad(rad), m_surface(std::move(surface))
+{
+    m_pos = pos;
+    this->euler_angles = euler_angles;
+    make_model_mat();
+    m_id = BaseSprite::id++;
+
+    const PlanetArray& heights = m_surface->heights;
+    if (heights.rows() != static_cast<size_t>(nTheta) || heights.cols() != static_cast<size_t>(nPhi))
+        throw std::invalid_argument("Planet surface does not match the grid size");
+
+    // Quantized heights go up as they are stored; the snorm decode gives
+    // q / INT16_MAX, which the scale turns back into the height.
+    if (heights.format() == HeightFormat::Quantized16) {
+        m_height_internal = GL_R16_SNORM;
+        m_height_bias = static_cast<float>(heights.nominalRadius());
+        m_height_scale = static_cast<float>(heights.quantRange());
+        m_textures[HEIGHTS] = createGridTexture(GL_R16_SNORM, GL_RED, GL_SHORT, nPhi, nTheta);
+    } else {
+        m_height_internal = GL_R32F;
+        m_textures[HEIGHTS] = createGridTexture(GL_R32F, GL_RED, GL_FLOAT, nPhi, nTheta);
+    }
+    m_textures[BIOME] = createGridTexture(GL_R8_SNORM, GL_RED, GL_BYTE, nPhi, nTheta);
+    m_textures[POLAR] = createGridTexture(GL_R32F, GL_RED, GL_FLOAT, nPhi, 1);
+
+    // Every planet of this resolution draws the same cached index list.
+    m_topology = topologies->acquire({static_cast<size_t>(nTheta), static_cast<size_t>(nPhi), GridLayout::LatLong});
+
+    if constexpr (DEBUG_PLANETS)
+        std::cout << nTheta * nPhi << " displaced samples, " << m_topology->numIndices() << " shared indices\n";
+}
+
+DisplacedPlanet::~DisplacedPlanet()
+{
+    glDeleteTextures(TEX_COUNT, m_textures);
+    if (m_transforms && m_transform_slot != TransformPool::INVALID)
+        m_transforms->release(m_transform_slot);
+}
+
+void DisplacedPlanet::setTransforms(std::shared_ptr<TransformPool> pool)
+{
+    if (m_transforms && m_transform_slot != TransformPool::INVALID)
+        m_transforms->release(m_transform_slot);
+    m_transforms = pool;
+    m_transform_slot = m_transforms ? m_transforms->allocate() : TransformPool::INVALID;
+    if (m_transforms)
+        m_transforms->set(m_transform_slot, m_model_matrix);
+}
+
+void DisplacedPlanet::setTransform(const glm::vec3& pos, const glm::vec3& euler_angles)
+{
+    m_pos = pos;
+    this->euler_angles = euler_angles;
+    make_model_mat();
+    if (m_transforms)
+        m_transforms->set(m_transform_slot, m_model_matrix);
+}
+
+PlanetSurface DisplacedPlanet::generate(const glm::vec3& /*pos*/, unsigned long long seed, int nTheta, int nPhi, double rad,
+                                        unsigned threads, MeshCache* cache)
+{
+    PlanetArray heights(nTheta, nPhi, rad, HeightFormat::Quantized16, Planet::HEIGHT_RANGE);
+    heights.setThreads(threads);
+
+    uint64_t key = MeshCache::planetKey(seed, nTheta, nPhi, rad, GridLayout::LatLong, CachedVertices::None);
+    auto cached = cache ? cache->load(key) : nullptr;
+    if (cached && cached->heightFormat() == heights.format() && cached->heights().size() == heights.bytes()) {
+        heights.assignRaw(cached->heights(), seed);
+    } else {
+        heights.fractal(seed);
+        // No vertices to store; a Planet finding this entry builds them
+        // from these heights.
+        if (cache)
+            cache->store(key, heights, {});
+    }
+
+    ShadingNoise noise = heights.shadingNoise();
+    return {std::move(heights), std::move(noise)};
+}
+
+void DisplacedPlanet::prepare(const Context& context, int nTheta, int nPhi)
+{
+    context.topologies->prepare({static_cast<size_t>(nTheta), static_cast<size_t>(nPhi), GridLayout::LatLong});
+}
+
+std::unique_ptr<DisplacedPlanet> DisplacedPlanet::create(const Context& context, const glm::vec3& pos, const glm::vec3& euler_angles,
+                                                         unsigned long long /*seed*/, Payload surface, int nTheta, int nPhi, double rad)
+{
+    if (!context.transforms)
+        throw std::logic_error("Planets need a transform pool");
+    auto planet = std::make_unique<DisplacedPlanet>(pos, euler_angles, context.topologies, std::move(surface), nTheta, nPhi, rad);
+    planet->setTransforms(context.transforms);
+    return planet;
+}
+
+size_t DisplacedPlanet::shipSome(size_t byte_budget)
+{
+    if (shipped())
+        return 0;
+
+    const PlanetArray& heights = m_surface->heights;
+    const size_t rows = heights.rows(), cols = heights.cols();
+    size_t used = 0;
+
+    // Heights first, then the biome noise, then the polar edge row.
+    while (m_height_rows < rows && used < byte_budget) {
+        size_t texel = m_height_internal == GL_R16_SNORM ? sizeof(int16_t) : sizeof(float);
+        size_t count = std::min(rows - m_height_rows, std::max<size_t>(1, (byte_budget - used) / (cols * texel)));
+        if (heights.format() == HeightFormat::Quantized16) {
+            uploadRows(m_textures[HEIGHTS], cols, m_height_rows, count, heights.bytes() / rows / sizeof(int16_t),
+                       GL_RED, GL_SHORT, heights.row<int16_t>(m_height_rows).data());
+        } else {
+            // Double rows are decoded straight into scratch; only Float
+            // rows, returned in place, need copying.
+            std::vector<float> scratch(count * cols);
+            for (size_t i = 0; i < count; i++) {
+                float* out = scratch.data() + i * cols;
+                auto row = heights.rowHeights(m_height_rows + i, out);
+                if (row.data() != out)
+                    std::copy(row.begin(), row.end(), out);
+            }
+            uploadRows(m_textures[HEIGHTS], cols, m_height_rows, count, cols, GL_RED, GL_FLOAT, scratch.data());
+        }
+        m_height_rows += count;
+        used += count * cols * texel;
+    }
+
+    while (m_height_rows == rows && m_biome_rows < rows && used < byte_budget) {
+        size_t count = std::min(rows - m_biome_rows, std::max<size_t>(1, (byte_budget - used) / cols));
+        uploadRows(m_textures[BIOME], cols, m_biome_rows, count, cols, GL_RED, GL_BYTE,
+                   m_surface->noise.biome.data() + m_biome_rows * cols);
+        m_biome_rows += count;
+        used += count * cols;
+    }
+
+    if (m_biome_rows == rows && used < byte_budget) {
+        uploadRows(m_textures[POLAR], cols, 0, 1, cols, GL_RED, GL_FLOAT, m_surface->noise.polar.data());
+        used += cols * sizeof(float);
+        m_surface.reset();
+    }
+    return used;
+}
+
+DisplacedPlanet::Uniforms::Uniforms(const Shader& shader)
+    : shader(shader), heights(shader.uniform("uHeights")), biome(shader.uniform("uBiome")),
+      polar(shader.uniform("uPolar")), nTheta(shader.uniform("uNTheta")), nPhi(shader.uniform("uNPhi")),
+      heightBias(shader.uniform("uHeightBias")), heightScale(shader.uniform("uHeightScale")),
+      nominalRad(shader.uniform("uNominalRad"))
+{
+}
+
+void DisplacedPlanet::draw(const Uniforms& uniforms) const
+{
+    if (!shipped())
+        return;
+
+    for (int k = 0; k < TEX_COUNT; k++) {
+        glActiveTexture(GL_TEXTURE0 + k);
+        glBindTexture(GL_TEXTURE_2D, m_textures[k]);
+    }
+    const Shader& shader = uniforms.shader;
+    shader.setInt(uniforms.heights, HEIGHTS);
+    shader.setInt(uniforms.biome, BIOME);
+    shader.setInt(uniforms.polar, POLAR);
+    shader.setInt(uniforms.nTheta, m_nTheta);
+    shader.setInt(uniforms.nPhi, m_nPhi);
+    shader.setFloat(uniforms.heightBias, m_height_bias);
+    shader.setFloat(uniforms.heightScale, m_height_scale);
+    shader.setFloat(uniforms.nominalRad, static_cast<float>(m_rad));
+
+    // Base vertex 0, so gl_VertexID is the grid sample each index names;
+    // the base instance picks the model matrix.
+    GLuint slot = m_transform_slot != TransformPool::INVALID ? static_cast<GLuint>(m_transform_slot) : 0;
+    glDrawElementsInstancedBaseInstance(GL_TRIANGLES, static_cast<GLsizei>(m_topology->numIndices()), GL_UNSIGNED_INT,
+                                        (const void*)(m_topology->firstIndex() * sizeof(unsigned int)), 1, slot);
+}
+
+size_t DisplacedPlanet::gpuBytes() const
+{
+    size_t samples = static_cast<size_t>(m_nTheta) * m_nPhi;
+    size_t height_texel = m_height_internal == GL_R16_SNORM ? sizeof(int16_t) : sizeof(float);
+    return samples * (height_texel + sizeof(int8_t)) + m_nPhi * sizeof(float);
+}
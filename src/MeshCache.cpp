@@ -0,0 +1,195 @@
+#include "MeshCache.hpp"
+
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+// Bumped whenever the on-disk layout below changes.
+static constexpr uint32_t CACHE_FORMAT_VERSION = 1;
+static constexpr char CACHE_MAGIC[8] = {'O', 'R', 'B', 'M', 'E', 'S', 'H', '\0'};
+static constexpr size_t SECTION_ALIGN = 64;
+
+namespace {
+
+struct Section {
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t generatorVersion;
+    uint64_t key;
+    uint32_t vertexSize;
+    uint32_t heightFormat;
+    Section heights;
+    Section vertices;
+    Section indices;
+};
+
+size_t alignUp(size_t n)
+{
+    return (n + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+}
+
+bool writeAll(int fd, const void* data, size_t bytes)
+{
+    auto p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = ::write(fd, p, bytes);
+        if (n <= 0)
+            return false;
+        p += n;
+        bytes -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool sectionFits(const Section& s, size_t file_size)
+{
+    return s.offset % SECTION_ALIGN == 0 && s.offset <= file_size && s.bytes <= file_size - s.offset;
+}
+
+} // namespace
+
+CachedPlanetMesh::~CachedPlanetMesh()
+{
+    if (m_map)
+        munmap(m_map, m_size);
+}
+
+MeshCache::MeshCache(std::filesystem::path dir)
+    : m_dir(std::move(dir))
+{
+    std::error_code ec;
+    std::filesystem::create_directories(m_dir, ec);
+}
+
+uint64_t MeshCache::planetKey(unsigned long long seed, int nTheta, int nPhi, double rad,
+                              GridLayout layout, CachedVertices vertices)
+{
+    uint64_t key = seedHash(seed, PLANET_GENERATOR_VERSION);
+    key = seedHash(key, static_cast<uint64_t>(nTheta));
+    key = seedHash(key, static_cast<uint64_t>(nPhi));
+    key = seedHash(key, std::bit_cast<uint64_t>(rad));
+    key = seedHash(key, static_cast<uint64_t>(vertices));
+    if (vertices != CachedVertices::None)
+        key = seedHash(key, static_cast<uint64_t>(layout));
+    return key;
+}
+
+std::filesystem::path MeshCache::entryPath(uint64_t key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.mesh", static_cast<unsigned long long>(key));
+    return m_dir / name;
+}
+
+std::shared_ptr<const CachedPlanetMesh> MeshCache::load(uint64_t key)
+{
+    int fd = ::open(entryPath(key).c_str(), O_RDONLY);
+    if (fd < 0) {
+        m_misses++;
+        return nullptr;
+    }
+
+    struct stat st;
+    size_t size = fstat(fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    void* map = size >= sizeof(FileHeader)
+        ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0)
+        : MAP_FAILED;
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        m_misses++;
+        return nullptr;
+    }
+
+    std::shared_ptr<CachedPlanetMesh> entry(new CachedPlanetMesh());
+    entry->m_map = map;
+    entry->m_size = size;
+
+    FileHeader header;
+    std::memcpy(&header, map, sizeof(header));
+    bool valid = std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+        && header.formatVersion == CACHE_FORMAT_VERSION
+        && header.generatorVersion == PLANET_GENERATOR_VERSION
+        && header.key == key
+        && header.vertexSize == sizeof(P_N_C)
+        && header.heightFormat <= static_cast<uint32_t>(HeightFormat::Quantized16)
+        && sectionFits(header.heights, size)
+        && sectionFits(header.vertices, size) && header.vertices.bytes % sizeof(P_N_C) == 0
+        && sectionFits(header.indices, size) && header.indices.bytes % sizeof(unsigned int) == 0;
+    if (!valid) {
+        m_misses++;
+        return nullptr;
+    }
+
+    auto base = static_cast<const std::byte*>(map);
+    entry->m_heights = {base + header.heights.offset, header.heights.bytes};
+    entry->m_vertices = {reinterpret_cast<const P_N_C*>(base + header.vertices.offset), header.vertices.bytes / sizeof(P_N_C)};
+    entry->m_indices = {reinterpret_cast<const unsigned int*>(base + header.indices.offset), header.indices.bytes / sizeof(unsigned int)};
+    entry->m_height_format = static_cast<HeightFormat>(header.heightFormat);
+
+    m_hits++;
+    m_bytes_mapped += size;
+    return entry;
+}
+
+void MeshCache::store(uint64_t key, const PlanetArray& heights, std::span<const P_N_C> vertices,
+                      std::span<const unsigned int> indices)
+{
+    FileHeader header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.formatVersion = CACHE_FORMAT_VERSION;
+    header.generatorVersion = PLANET_GENERATOR_VERSION;
+    header.key = key;
+    header.vertexSize = sizeof(P_N_C);
+    header.heightFormat = static_cast<uint32_t>(heights.format());
+    header.heights = {alignUp(sizeof(FileHeader)), heights.bytes()};
+    header.vertices = {alignUp(header.heights.offset + header.heights.bytes), vertices.size_bytes()};
+    header.indices = {alignUp(header.vertices.offset + header.vertices.bytes), indices.size_bytes()};
+
+    // Unique per thread, so concurrent stores of the same key do not collide.
+    std::filesystem::path final_path = entryPath(key);
+    std::filesystem::path tmp_path = final_path;
+    tmp_path += "." + std::to_string(::getpid()) + "." +
+        std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+
+    static const std::byte zeros[SECTION_ALIGN] = {};
+    size_t written = 0;
+    auto put = [&](const Section& section, const void* data) {
+        return writeAll(fd, zeros, section.offset - written)
+            && writeAll(fd, data, section.bytes)
+            && (written = section.offset + section.bytes, true);
+    };
+    bool ok = writeAll(fd, &header, sizeof(header));
+    written = sizeof(header);
+    ok = ok && put(header.heights, heights.raw().data())
+            && put(header.vertices, vertices.data())
+            && put(header.indices, indices.data());
+    ok = ::close(fd) == 0 && ok;
+
+    std::error_code ec;
+    if (ok)
+        std::filesystem::rename(tmp_path, final_path, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(tmp_path, ec);
+        return;
+    }
+    m_stores++;
+}
+
+MeshCacheStats MeshCache::stats() const
+{
+    return {m_hits.load(), m_misses.load(), m_stores.load(), m_bytes_mapped.load()};
+}
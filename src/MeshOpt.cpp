@@ -0,0 +1,213 @@
+#include "MeshOpt.hpp"
+
+#include <limits>
+#include <tuple>
+
+namespace {
+
+// Triangles around each vertex: those of vertex v are
+// adjacency[first[v]..first[v + 1]).
+std::pair<std::vector<size_t>, std::vector<unsigned int>> vertexTriangles(std::span<const unsigned int> indices,
+                                                                          size_t vertex_count)
+{
+    const size_t triangles = indices.size() / 3;
+    std::vector<size_t> first(vertex_count + 1, 0);
+    for (unsigned int v : indices.first(triangles * 3))
+        first[v + 1]++;
+    std::partial_sum(first.begin(), first.end(), first.begin());
+    std::vector<unsigned int> adjacency(first.back());
+    std::vector<size_t> fill(first.begin(), first.end() - 1);
+    for (size_t t = 0; t < triangles; ++t) {
+        for (size_t c = 0; c < 3; ++c)
+            adjacency[fill[indices[t * 3 + c]]++] = static_cast<unsigned int>(t);
+    }
+    return {std::move(first), std::move(adjacency)};
+}
+
+} // namespace
+
+double acmr(std::span<const unsigned int> indices, size_t vertex_count, size_t cache_size)
+{
+    if (indices.size() < 3)
+        return 0.0;
+
+    // A vertex is cached while fewer than cache_size others were loaded
+    // since it was; stamps start out of the cache.
+    std::vector<size_t> loaded_at(vertex_count, 0);
+    size_t loads = cache_size, misses = 0;
+    for (unsigned int v : indices) {
+        if (loads - loaded_at[v] >= cache_size) {
+            loaded_at[v] = loads++;
+            misses++;
+        }
+    }
+    return static_cast<double>(misses) / (indices.size() / 3);
+}
+
+std::vector<unsigned int> tipsify(std::span<const unsigned int> indices, size_t vertex_count, size_t cache_size)
+{
+    const size_t triangles = indices.size() / 3;
+    auto [first, adjacency] = vertexTriangles(indices, vertex_count);
+
+    // Triangles not yet emitted around each vertex.
+    std::vector<unsigned int> live(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+        live[v] = static_cast<unsigned int>(first[v + 1] - first[v]);
+
+    std::vector<size_t> cached_at(vertex_count, 0);
+    std::vector<bool> emitted(triangles, false);
+    std::vector<unsigned int> dead_ends;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> out;
+    out.reserve(triangles * 3);
+
+    size_t time = cache_size + 1;
+    size_t cursor = 0;
+    constexpr size_t NONE = std::numeric_limits<size_t>::max();
+    size_t fan = vertex_count > 0 && triangles > 0 ? 0 : NONE;
+
+    while (fan != NONE) {
+        // Emit every remaining triangle around the fanning vertex.
+        candidates.clear();
+        for (size_t a = first[fan]; a < first[fan + 1]; ++a) {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            for (size_t c = 0; c < 3; ++c) {
+                unsigned int v = indices[t * 3 + c];
+                out.push_back(v);
+                dead_ends.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cached_at[v] > cache_size)
+                    cached_at[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // Next fan: the candidate still in the cache that has been there
+        // longest, as long as its triangles would not push it out. Others
+        // are left to the dead-end search below.
+        fan = NONE;
+        size_t best = 0;
+        for (unsigned int v : candidates) {
+            if (live[v] == 0 || time - cached_at[v] + 2 * live[v] > cache_size)
+                continue;
+            size_t priority = time - cached_at[v];
+            if (priority > best) {
+                best = priority;
+                fan = v;
+            }
+        }
+        if (fan != NONE)
+            continue;
+
+        // Dead end: back up through recently used vertices, then scan
+        // forward for any vertex with triangles left.
+        while (!dead_ends.empty() && fan == NONE) {
+            unsigned int v = dead_ends.back();
+            dead_ends.pop_back();
+            if (live[v] > 0)
+                fan = v;
+        }
+        while (fan == NONE && cursor < vertex_count) {
+            if (live[cursor] > 0)
+                fan = cursor;
+            cursor++;
+        }
+    }
+    return out;
+}
+
+std::pair<std::vector<unsigned int>, ChunkOffsets> clusterTriangles(std::span<const unsigned int> indices, size_t vertex_count,
+                                                                    size_t cluster_triangles)
+{
+    const size_t triangles = indices.size() / 3;
+    auto [first, adjacency] = vertexTriangles(indices, vertex_count);
+
+    // Grow each cluster breadth-first over shared vertices from the first
+    // triangle not yet taken, so it covers a roughly round patch.
+    std::vector<bool> taken(triangles, false);
+    std::vector<unsigned int> queue;
+    std::vector<unsigned int> out;
+    out.reserve(triangles * 3);
+    ChunkOffsets clusters;
+    size_t seed = 0;
+    while (seed < triangles) {
+        if (taken[seed]) {
+            seed++;
+            continue;
+        }
+        clusters.push_back(out.size());
+        queue.assign(1, static_cast<unsigned int>(seed));
+        taken[seed] = true;
+        size_t size = 0;
+        for (size_t q = 0; q < queue.size() && size < cluster_triangles; ++q) {
+            unsigned int t = queue[q];
+            out.insert(out.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+            size++;
+            for (size_t c = 0; c < 3; ++c) {
+                unsigned int v = indices[t * 3 + c];
+                for (size_t a = first[v]; a < first[v + 1]; ++a) {
+                    if (!taken[adjacency[a]]) {
+                        taken[adjacency[a]] = true;
+                        queue.push_back(adjacency[a]);
+                    }
+                }
+            }
+        }
+        // Queued triangles that did not fit go back to the pool.
+        for (size_t q = size; q < queue.size(); ++q)
+            taken[queue[q]] = false;
+    }
+    clusters.push_back(out.size());
+    return {std::move(out), std::move(clusters)};
+}
+
+std::vector<unsigned int> fetchRemap(std::span<const unsigned int> indices, size_t vertex_count)
+{
+    constexpr unsigned int UNUSED = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> remap(vertex_count, UNUSED);
+    unsigned int next = 0;
+    for (unsigned int v : indices) {
+        if (remap[v] == UNUSED)
+            remap[v] = next++;
+    }
+    for (auto& r : remap) {
+        if (r == UNUSED)
+            r = next++;
+    }
+    return remap;
+}
+
+MeshOptStats optimizeIndices(std::vector<unsigned int>& indices, size_t vertex_count, ChunkOffsets& chunks)
+{
+    MeshOptStats stats;
+    stats.acmrBefore = acmr(indices, vertex_count);
+    std::tie(indices, chunks) = clusterTriangles(indices, vertex_count);
+
+    // Each cluster is tipsified over its own vertices, numbered from 0, so
+    // the work stays linear in the mesh instead of clusters x vertices.
+    constexpr unsigned int UNUSED = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> local(vertex_count, UNUSED);
+    std::vector<unsigned int> global;
+    std::vector<unsigned int> cluster;
+    for (size_t k = 0; k + 1 < chunks.size(); ++k) {
+        global.clear();
+        cluster.assign(indices.begin() + chunks[k], indices.begin() + chunks[k + 1]);
+        for (auto& v : cluster) {
+            if (local[v] == UNUSED) {
+                local[v] = static_cast<unsigned int>(global.size());
+                global.push_back(v);
+            }
+            v = local[v];
+        }
+        auto order = tipsify(cluster, global.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            indices[chunks[k] + i] = global[order[i]];
+        for (unsigned int v : global)
+            local[v] = UNUSED;
+    }
+    stats.acmrAfter = acmr(indices, vertex_count);
+    return stats;
+}
@@ -0,0 +1,166 @@
+#include "Occlusion.hpp"
+
+#include <immintrin.h>
+
+#include "Simd.hpp"
+
+namespace {
+
+// Depth at which the view rays through n pixel corners first hit a sphere
+// at view-space center with squared radius radius2, INFINITY for rays that
+// miss. Corner k is at NDC (x0 + k * step, y); scale_x and scale_y undo
+// the projection, so the ray through it is (x / scale_x, y / scale_y, -1)
+// and the distance along it is the depth.
+struct CornerRow {
+    glm::vec3 center;
+    float c; // |center|^2 - radius^2, > 0 as the eye is outside
+    float x0, step, y;
+    float scale_x, scale_y;
+};
+
+void cornersScalar(const CornerRow& row, float* out, size_t n)
+{
+    float dy = row.y / row.scale_y;
+    for (size_t k = 0; k < n; ++k) {
+        float dx = (row.x0 + k * row.step) / row.scale_x;
+        float a = dx * dx + dy * dy + 1.0f;
+        float b = dx * row.center.x + dy * row.center.y - row.center.z;
+        float disc = b * b - a * row.c;
+        out[k] = disc >= 0.0f && b > 0.0f ? (b - std::sqrt(disc)) / a : INFINITY;
+    }
+}
+
+__attribute__((target("avx2")))
+void cornersAVX2(const CornerRow& row, float* out, size_t n)
+{
+    const float dy = row.y / row.scale_y;
+    const __m256 inv_scale = _mm256_set1_ps(1.0f / row.scale_x);
+    const __m256 a0 = _mm256_set1_ps(dy * dy + 1.0f);
+    const __m256 b0 = _mm256_set1_ps(dy * row.center.y - row.center.z);
+    const __m256 cx = _mm256_set1_ps(row.center.x);
+    const __m256 c = _mm256_set1_ps(row.c);
+    const __m256 step = _mm256_set1_ps(row.step);
+    const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 miss = _mm256_set1_ps(INFINITY);
+
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256 x = _mm256_add_ps(_mm256_set1_ps(row.x0 + k * row.step), _mm256_mul_ps(lanes, step));
+        __m256 dx = _mm256_mul_ps(x, inv_scale);
+        __m256 a = _mm256_add_ps(_mm256_mul_ps(dx, dx), a0);
+        __m256 b = _mm256_add_ps(_mm256_mul_ps(dx, cx), b0);
+        __m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c));
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(disc, zero, _CMP_GE_OQ), _mm256_cmp_ps(b, zero, _CMP_GT_OQ));
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(b, _mm256_sqrt_ps(_mm256_max_ps(disc, zero))), a);
+        _mm256_storeu_ps(out + k, _mm256_blendv_ps(miss, t, hit));
+    }
+    CornerRow rest = row;
+    rest.x0 = row.x0 + k * row.step;
+    cornersScalar(rest, out + k, n - k);
+}
+
+void corners(const CornerRow& row, float* out, size_t n)
+{
+    if (simdLevel() == SimdLevel::AVX2)
+        cornersAVX2(row, out, n);
+    else
+        cornersScalar(row, out, n);
+}
+
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer(size_t width, size_t height)
+    : m_width(std::max<size_t>(width, 1)), m_height(std::max<size_t>(height, 1)),
+      m_depth(m_width * m_height, INFINITY), m_corners(2 * (m_width + 1))
+{
+}
+
+void OcclusionBuffer::begin(const glm::mat4& view, const glm::mat4& projection)
+{
+    m_view = view;
+    m_scale_x = projection[0][0];
+    m_scale_y = projection[1][1];
+    // projection[3][2] = -2fn / (f - n), projection[2][2] = -(f + n) / (f - n)
+    m_near = projection[3][2] / (projection[2][2] - 1.0f);
+    std::fill(m_depth.begin(), m_depth.end(), INFINITY);
+}
+
+bool OcclusionBuffer::screenRect(const glm::vec3& center, float radius, Rect& rect) const
+{
+    float depth = -center.z;
+    if (depth - radius <= m_near)
+        return false;
+
+    // The sphere's box, projected: x / depth is monotonic in both, so its
+    // extremes are at the box's corners.
+    auto extent = [&](float c, float scale, size_t pixels, size_t& lo, size_t& hi) {
+        float near_depth = depth - radius, far_depth = depth + radius;
+        float a = (c - radius) / near_depth, b = (c - radius) / far_depth;
+        float d = (c + radius) / near_depth, e = (c + radius) / far_depth;
+        float ndc_lo = std::min({a, b, d, e}) * scale, ndc_hi = std::max({a, b, d, e}) * scale;
+        float p_lo = std::floor((ndc_lo + 1.0f) * 0.5f * pixels);
+        float p_hi = std::ceil((ndc_hi + 1.0f) * 0.5f * pixels);
+        lo = static_cast<size_t>(std::clamp(p_lo, 0.0f, static_cast<float>(pixels)));
+        hi = static_cast<size_t>(std::clamp(p_hi, 0.0f, static_cast<float>(pixels)));
+    };
+    extent(center.x, m_scale_x, m_width, rect.x0, rect.x1);
+    extent(center.y, m_scale_y, m_height, rect.y0, rect.y1);
+    return true;
+}
+
+void OcclusionBuffer::rasterize(const Occluder& occluder)
+{
+    glm::vec3 center(m_view * glm::vec4(occluder.center, 1.0f));
+    float c = glm::dot(center, center) - occluder.radius * occluder.radius;
+    if (occluder.radius <= 0.0f || c <= 0.0f)
+        return;
+
+    Rect rect;
+    if (!screenRect(center, occluder.radius, rect))
+        rect = {0, 0, m_width, m_height};
+    if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1)
+        return;
+
+    // A pixel is written only if the sphere covers all four of its corners,
+    // and so all of it (the sphere's outline is convex), with the largest
+    // of their depths: seen from the eye, the front of a sphere and all
+    // behind it is convex, so the depth of its front is a convex function
+    // of screen position and peaks over a pixel at a corner.
+    const size_t n = rect.x1 - rect.x0 + 1;
+    float* below = m_corners.data();
+    float* above = m_corners.data() + m_width + 1;
+    CornerRow row{center, c, -1.0f + 2.0f * rect.x0 / m_width, 2.0f / m_width, 0.0f, m_scale_x, m_scale_y};
+    for (size_t j = rect.y0; j <= rect.y1; ++j) {
+        row.y = -1.0f + 2.0f * j / m_height;
+        corners(row, above, n);
+        if (j > rect.y0) {
+            float* depth = m_depth.data() + (j - 1) * m_width + rect.x0;
+            for (size_t i = 0; i + 1 < n; ++i) {
+                float d = std::max(std::max(below[i], below[i + 1]), std::max(above[i], above[i + 1]));
+                depth[i] = std::min(depth[i], d);
+            }
+        }
+        std::swap(below, above);
+    }
+}
+
+bool OcclusionBuffer::occluded(const BoundingSphere& sphere) const
+{
+    if (!std::isfinite(sphere.radius))
+        return false;
+    glm::vec3 center(m_view * glm::vec4(sphere.center, 1.0f));
+    Rect rect;
+    if (!screenRect(center, sphere.radius, rect) || rect.x0 >= rect.x1 || rect.y0 >= rect.y1)
+        return false;
+
+    float nearest = -center.z - sphere.radius;
+    for (size_t j = rect.y0; j < rect.y1; ++j) {
+        const float* depth = m_depth.data() + j * m_width;
+        for (size_t i = rect.x0; i < rect.x1; ++i) {
+            if (!(depth[i] < nearest))
+                return false;
+        }
+    }
+    return true;
+}
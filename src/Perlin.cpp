@@ -0,0 +1,288 @@
+#include "Perlin.hpp"
+
+#include <immintrin.h>
+
+// Batched Perlin kernels. Each one mirrors PerlinNoise::noise() operation for
+// operation (same fade/lerp/grad order, no FMA) so the results only differ
+// where fmodf and the vector wrap round differently.
+
+#define AVX2_FN static inline __attribute__((target("avx2"), always_inline))
+#define SSE41_FN static inline __attribute__((target("sse4.1"), always_inline))
+
+namespace {
+
+// fmodf(v, r), then + r if negative
+AVX2_FN __m256 wrap8(__m256 v, __m256 r) {
+    __m256 m = _mm256_sub_ps(v, _mm256_mul_ps(_mm256_floor_ps(_mm256_div_ps(v, r)), r));
+    return _mm256_add_ps(m, _mm256_and_ps(r, _mm256_cmp_ps(m, _mm256_setzero_ps(), _CMP_LT_OQ)));
+}
+
+// c % r for c in [0, r]
+AVX2_FN __m256i cell8(__m256i c, __m256i r) {
+    return _mm256_sub_epi32(c, _mm256_and_si256(r, _mm256_cmpeq_epi32(c, r)));
+}
+
+// Wraps one coordinate and splits it into the fractional part and the two
+// (wrapped, & 255) lattice cells either side of it.
+AVX2_FN __m256 axis8(__m256 v, __m256 r, __m256i ir, __m256i& c0, __m256i& c1) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i m255 = _mm256_set1_epi32(255);
+    v = wrap8(v, r);
+    __m256 fl = _mm256_floor_ps(v);
+    c0 = cell8(_mm256_cvttps_epi32(fl), ir);
+    c1 = _mm256_and_si256(cell8(_mm256_add_epi32(c0, one), ir), m255);
+    c0 = _mm256_and_si256(c0, m255);
+    return _mm256_sub_ps(v, fl);
+}
+
+AVX2_FN __m256 fade8(__m256 t) {
+    __m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+}
+
+AVX2_FN __m256 lerp8(__m256 a, __m256 b, __m256 t) {
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+AVX2_FN __m256 grad8(__m256i h, __m256 x, __m256 y) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    h = _mm256_and_si256(h, _mm256_set1_epi32(7));
+    __m256 lt4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+    __m256 u = _mm256_blendv_ps(y, x, lt4);
+    __m256 v = _mm256_mul_ps(_mm256_set1_ps(2.0f), _mm256_blendv_ps(x, y, lt4));
+    __m256 negU = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(h, one), one));
+    __m256 negV = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(h, two), two));
+    return _mm256_add_ps(_mm256_xor_ps(u, _mm256_and_ps(sign, negU)), _mm256_xor_ps(v, _mm256_and_ps(sign, negV)));
+}
+
+SSE41_FN __m128 wrap4(__m128 v, __m128 r) {
+    __m128 m = _mm_sub_ps(v, _mm_mul_ps(_mm_floor_ps(_mm_div_ps(v, r)), r));
+    return _mm_add_ps(m, _mm_and_ps(r, _mm_cmplt_ps(m, _mm_setzero_ps())));
+}
+
+SSE41_FN __m128i cell4(__m128i c, __m128i r) {
+    return _mm_sub_epi32(c, _mm_and_si128(r, _mm_cmpeq_epi32(c, r)));
+}
+
+SSE41_FN __m128 axis4(__m128 v, __m128 r, __m128i ir, __m128i& c0, __m128i& c1) {
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i m255 = _mm_set1_epi32(255);
+    v = wrap4(v, r);
+    __m128 fl = _mm_floor_ps(v);
+    c0 = cell4(_mm_cvttps_epi32(fl), ir);
+    c1 = _mm_and_si128(cell4(_mm_add_epi32(c0, one), ir), m255);
+    c0 = _mm_and_si128(c0, m255);
+    return _mm_sub_ps(v, fl);
+}
+
+SSE41_FN __m128 fade4(__m128 t) {
+    __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+SSE41_FN __m128 lerp4(__m128 a, __m128 b, __m128 t) {
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+SSE41_FN __m128 grad4(__m128i h, __m128 x, __m128 y) {
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    h = _mm_and_si128(h, _mm_set1_epi32(7));
+    __m128 lt4 = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(4), h));
+    __m128 u = _mm_blendv_ps(y, x, lt4);
+    __m128 v = _mm_mul_ps(_mm_set1_ps(2.0f), _mm_blendv_ps(x, y, lt4));
+    __m128 negU = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(h, one), one));
+    __m128 negV = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(h, two), two));
+    return _mm_add_ps(_mm_xor_ps(u, _mm_and_ps(sign, negU)), _mm_xor_ps(v, _mm_and_ps(sign, negV)));
+}
+
+// No gather before AVX2: four scalar loads.
+SSE41_FN __m128i gather4(const int* p, __m128i idx) {
+    return _mm_setr_epi32(p[_mm_extract_epi32(idx, 0)], p[_mm_extract_epi32(idx, 1)],
+                          p[_mm_extract_epi32(idx, 2)], p[_mm_extract_epi32(idx, 3)]);
+}
+
+} // namespace
+
+struct PerlinKernels {
+    using Kernel = void (*)(const PerlinNoise&, const float*, bool, const float*, float*, size_t);
+
+    // Scalar fallback, also used for the tails of the vector kernels.
+    static void scalar(const PerlinNoise& pn, const float* xs, bool constX, const float* ys, float* out, size_t n) {
+        for (size_t k = 0; k < n; ++k)
+            out[k] = pn.noise(constX ? xs[0] : xs[k], ys[k]);
+    }
+
+    __attribute__((target("avx2")))
+    static void avx2(const PerlinNoise& pn, const float* xs, bool constX, const float* ys, float* out, size_t n) {
+        const int* p = pn.p.data();
+        const __m256 rx = _mm256_set1_ps(float(pn.repeatX_));
+        const __m256 ry = _mm256_set1_ps(float(pn.repeatY_));
+        const __m256i irx = _mm256_set1_epi32(pn.repeatX_);
+        const __m256i iry = _mm256_set1_epi32(pn.repeatY_);
+        const __m256 fone = _mm256_set1_ps(1.0f);
+
+        // For a row (constant x) the x half of the lattice lookup is done once.
+        __m256i px0, px1;
+        __m256 xf = axis8(_mm256_set1_ps(xs[0]), rx, irx, px0, px1);
+        px0 = _mm256_i32gather_epi32(p, px0, 4);
+        px1 = _mm256_i32gather_epi32(p, px1, 4);
+
+        size_t k = 0;
+        for (; k + 8 <= n; k += 8) {
+            if (!constX) {
+                xf = axis8(_mm256_loadu_ps(xs + k), rx, irx, px0, px1);
+                px0 = _mm256_i32gather_epi32(p, px0, 4);
+                px1 = _mm256_i32gather_epi32(p, px1, 4);
+            }
+            __m256i yi, yi1;
+            __m256 yf = axis8(_mm256_loadu_ps(ys + k), ry, iry, yi, yi1);
+            __m256 u = fade8(xf);
+            __m256 v = fade8(yf);
+
+            __m256i aa = _mm256_i32gather_epi32(p, _mm256_add_epi32(px0, yi), 4);
+            __m256i ab = _mm256_i32gather_epi32(p, _mm256_add_epi32(px0, yi1), 4);
+            __m256i ba = _mm256_i32gather_epi32(p, _mm256_add_epi32(px1, yi), 4);
+            __m256i bb = _mm256_i32gather_epi32(p, _mm256_add_epi32(px1, yi1), 4);
+
+            __m256 xf1 = _mm256_sub_ps(xf, fone);
+            __m256 yf1 = _mm256_sub_ps(yf, fone);
+            __m256 x1 = lerp8(grad8(aa, xf, yf), grad8(ba, xf1, yf), u);
+            __m256 x2 = lerp8(grad8(ab, xf, yf1), grad8(bb, xf1, yf1), u);
+            _mm256_storeu_ps(out + k, lerp8(x1, x2, v));
+        }
+        scalar(pn, constX ? xs : xs + k, constX, ys + k, out + k, n - k);
+    }
+
+    __attribute__((target("sse4.1")))
+    static void sse41(const PerlinNoise& pn, const float* xs, bool constX, const float* ys, float* out, size_t n) {
+        const int* p = pn.p.data();
+        const __m128 rx = _mm_set1_ps(float(pn.repeatX_));
+        const __m128 ry = _mm_set1_ps(float(pn.repeatY_));
+        const __m128i irx = _mm_set1_epi32(pn.repeatX_);
+        const __m128i iry = _mm_set1_epi32(pn.repeatY_);
+        const __m128 fone = _mm_set1_ps(1.0f);
+
+        __m128i px0, px1;
+        __m128 xf = axis4(_mm_set1_ps(xs[0]), rx, irx, px0, px1);
+        px0 = gather4(p, px0);
+        px1 = gather4(p, px1);
+
+        size_t k = 0;
+        for (; k + 4 <= n; k += 4) {
+            if (!constX) {
+                xf = axis4(_mm_loadu_ps(xs + k), rx, irx, px0, px1);
+                px0 = gather4(p, px0);
+                px1 = gather4(p, px1);
+            }
+            __m128i yi, yi1;
+            __m128 yf = axis4(_mm_loadu_ps(ys + k), ry, iry, yi, yi1);
+            __m128 u = fade4(xf);
+            __m128 v = fade4(yf);
+
+            __m128i aa = gather4(p, _mm_add_epi32(px0, yi));
+            __m128i ab = gather4(p, _mm_add_epi32(px0, yi1));
+            __m128i ba = gather4(p, _mm_add_epi32(px1, yi));
+            __m128i bb = gather4(p, _mm_add_epi32(px1, yi1));
+
+            __m128 xf1 = _mm_sub_ps(xf, fone);
+            __m128 yf1 = _mm_sub_ps(yf, fone);
+            __m128 x1 = lerp4(grad4(aa, xf, yf), grad4(ba, xf1, yf), u);
+            __m128 x2 = lerp4(grad4(ab, xf, yf1), grad4(bb, xf1, yf1), u);
+            _mm_storeu_ps(out + k, lerp4(x1, x2, v));
+        }
+        scalar(pn, constX ? xs : xs + k, constX, ys + k, out + k, n - k);
+    }
+
+    static Kernel select() {
+        switch (simdLevel()) {
+            case SimdLevel::AVX2:  return avx2;
+            case SimdLevel::SSE41: return sse41;
+            default:               return scalar;
+        }
+    }
+
+    static void run(const PerlinNoise& pn, const float* xs, bool constX, const float* ys, float* out, size_t n) {
+        static const Kernel kernel = select();
+        if (n == 0)
+            return;
+        // The vector wrap assumes positive periods; noise() itself divides by them.
+        if (pn.repeatX_ <= 0 || pn.repeatY_ <= 0)
+            return scalar(pn, xs, constX, ys, out, n);
+        kernel(pn, xs, constX, ys, out, n);
+    }
+};
+
+void PerlinNoise::noise_n(const float* xs, const float* ys, float* out, size_t n) const {
+    PerlinKernels::run(*this, xs, false, ys, out, n);
+}
+
+void PerlinNoise::noise_row(float x, const float* ys, float* out, size_t n) const {
+    PerlinKernels::run(*this, &x, true, ys, out, n);
+}
+
+// Octaves are evaluated a chunk at a time so the scratch stays on the stack.
+// Coordinates and the running sum are kept in double like noise() does.
+static constexpr size_t FRACTAL_CHUNK = 256;
+
+void FractalNoise::noise_n(const float* xs, const float* ys, float* out, size_t n) const {
+    noise_n(xs, ys, out, n, m_octaves);
+}
+
+void FractalNoise::noise_n(const float* xs, const float* ys, float* out, size_t n, int octaves) const {
+    size_t count = static_cast<size_t>(std::clamp(octaves, 0, m_octaves));
+    float tx[FRACTAL_CHUNK], ty[FRACTAL_CHUNK], oct[FRACTAL_CHUNK];
+    double acc[FRACTAL_CHUNK];
+
+    for (size_t base = 0; base < n; base += FRACTAL_CHUNK) {
+        size_t len = std::min(FRACTAL_CHUNK, n - base);
+        std::fill(acc, acc + len, 0.0);
+
+        double amplitude = 1.0;
+        double freq = m_initial_freq;
+        for (size_t i = 0; i < count; ++i) {
+            const PerlinNoise& p = m_perlins[i];
+            for (size_t k = 0; k < len; ++k) {
+                tx[k] = static_cast<float>(xs[base + k] * freq + 0.5);
+                ty[k] = static_cast<float>(ys[base + k] * freq + 0.5);
+            }
+            p.noise_n(tx, ty, oct, len);
+            for (size_t k = 0; k < len; ++k)
+                acc[k] += m_scale0 * oct[k] * amplitude;
+            amplitude /= m_lacunarity;
+            freq *= m_lacunarity;
+        }
+        for (size_t k = 0; k < len; ++k)
+            out[base + k] = static_cast<float>(acc[k]);
+    }
+}
+
+void FractalNoise::noise_row(double x, double y0, double dy, float* out, size_t n) const {
+    float ty[FRACTAL_CHUNK], oct[FRACTAL_CHUNK];
+    double ys[FRACTAL_CHUNK], acc[FRACTAL_CHUNK];
+
+    for (size_t base = 0; base < n; base += FRACTAL_CHUNK) {
+        size_t len = std::min(FRACTAL_CHUNK, n - base);
+        std::fill(acc, acc + len, 0.0);
+        for (size_t k = 0; k < len; ++k)
+            ys[k] = y0 + double(base + k) * dy;
+
+        double amplitude = 1.0;
+        double freq = m_initial_freq;
+        for (const auto& p : m_perlins) {
+            float tx = static_cast<float>(x * freq + 0.5);
+            for (size_t k = 0; k < len; ++k)
+                ty[k] = static_cast<float>(ys[k] * freq + 0.5);
+            p.noise_row(tx, ty, oct, len);
+            for (size_t k = 0; k < len; ++k)
+                acc[k] += m_scale0 * oct[k] * amplitude;
+            amplitude /= m_lacunarity;
+            freq *= m_lacunarity;
+        }
+        for (size_t k = 0; k < len; ++k)
+            out[base + k] = static_cast<float>(acc[k]);
+    }
+}
@@ -1,41 +1,240 @@
 #include "ProcGen.hpp"
 
 #include "Perlin.hpp"
+#include "Parallel.hpp"
 
-// Constructor: initialize with a given capacity.
-PlanetArray::PlanetArray(size_t inTheta, size_t inPhi, double rad)
+// seedHash() counter for the biome/polar colour noise stream. Octaves of the
+// height noise use counters 0..octaves-1 of the planet seed itself.
+static constexpr uint64_t COLOR_NOISE_STREAM = 0xC0102;
+
+// The color noise inputs, shared by shadeVertices() and shadingNoise() so
+// both see the same values.
+static FractalNoise colorNoise(unsigned long long seed, size_t nTheta)
+{
+    return FractalNoise(seedHash(seed, COLOR_NOISE_STREAM), nTheta, nTheta, 2. / nTheta);
+}
+
+// The polar ice boundary noise only depends on the column.
+static std::vector<float> polarNoise(const FractalNoise& col_noise, size_t nPhi)
+{
+    std::vector<float> polar_x(nPhi), polar_y(nPhi, .5f), polar_noise(nPhi);
+    for (size_t j = 0; j < nPhi; ++j) {
+        polar_x[j] = j + .5f;
+    }
+    col_noise.noise_n(polar_x.data(), polar_y.data(), polar_noise.data(), nPhi);
+    return polar_noise;
+}
+
+// Biome variation for row i.
+static void biomeNoiseRow(const FractalNoise& col_noise, size_t i, size_t nTheta, size_t nPhi, float* out)
+{
+    col_noise.noise_row(32 * (i / (double) nTheta) + .5, .5, 32. / nPhi, out, nPhi);
+}
+
+// Constructor: initialize every sample to the nominal radius.
+PlanetArray::PlanetArray(size_t inTheta, size_t inPhi, double rad, HeightFormat format, double quant_range)
 {
     nTheta = (inTheta);
     nPhi = (inPhi);
     nominal_rad = rad;
-    data = std::vector<std::vector<double>>(nTheta, std::vector<double>(nPhi, rad));
+    m_format = format;
+    m_quant_step = quant_range / INT16_MAX;
+
+    // One contiguous allocation, every row padded out to a 64 byte boundary.
+    m_stride = (nPhi * elementSize(m_format) + 63) / 64 * 64;
+    m_data.reset(static_cast<std::byte*>(std::aligned_alloc(64, std::max<size_t>(bytes(), 64))));
+    if (!m_data)
+        throw std::bad_alloc();
+
+    for (size_t i = 0; i < nTheta; i++) {
+        switch (m_format) {
+            case HeightFormat::Float:       std::ranges::fill(row<float>(i), static_cast<float>(rad)); break;
+            case HeightFormat::Double:      std::ranges::fill(row<double>(i), rad); break;
+            case HeightFormat::Quantized16: std::ranges::fill(row<int16_t>(i), int16_t(0)); break;
+        }
+    }
+}
+
+void PlanetArray::assignRaw(std::span<const std::byte> data, unsigned long long seed)
+{
+    if (data.size() != bytes())
+        throw std::invalid_argument("Raw height data does not match the grid size");
+    std::copy(data.begin(), data.end(), m_data.get());
+    m_seed = seed;
+}
+
+size_t PlanetArray::elementSize(HeightFormat format)
+{
+    switch (format) {
+        case HeightFormat::Float:       return sizeof(float);
+        case HeightFormat::Double:      return sizeof(double);
+        case HeightFormat::Quantized16: return sizeof(int16_t);
+    }
+    throw std::invalid_argument("Unknown height format");
+}
+
+double PlanetArray::at(size_t i, size_t j) const
+{
+    switch (m_format) {
+        case HeightFormat::Float:       return row<float>(i)[j];
+        case HeightFormat::Double:      return row<double>(i)[j];
+        case HeightFormat::Quantized16: return nominal_rad + row<int16_t>(i)[j] * m_quant_step;
+    }
+    return nominal_rad;
+}
+
+void PlanetArray::set(size_t i, size_t j, double h)
+{
+    switch (m_format) {
+        case HeightFormat::Float:       row<float>(i)[j] = static_cast<float>(h); break;
+        case HeightFormat::Double:      row<double>(i)[j] = h; break;
+        case HeightFormat::Quantized16: {
+            double q = std::round((h - nominal_rad) / m_quant_step);
+            row<int16_t>(i)[j] = static_cast<int16_t>(std::clamp(q, double(-INT16_MAX), double(INT16_MAX)));
+            break;
+        }
+    }
+}
+
+std::span<const float> PlanetArray::rowHeights(size_t i, float* scratch) const
+{
+    if (m_format == HeightFormat::Float)
+        return row<float>(i);
+
+    for (size_t j = 0; j < nPhi; j++)
+        scratch[j] = static_cast<float>(at(i, j));
+    return {scratch, nPhi};
+}
+
+void PlanetArray::addToRow(size_t i, const float* delta)
+{
+    if (m_format == HeightFormat::Float) {
+        auto r = row<float>(i);
+        for (size_t j = 0; j < nPhi; j++)
+            r[j] += delta[j];
+        return;
+    }
+    for (size_t j = 0; j < nPhi; j++)
+        set(i, j, at(i, j) + delta[j]);
 }
 
 void PlanetArray::fractal(unsigned long long seed)
 {
+    m_seed = seed;
 
     FractalNoise f = FractalNoise(seed, nTheta, nPhi, 2. / nTheta);
 
+    // Whole rows at a time through the batched noise path.
+    parallelRows(nTheta, m_threads, [&](size_t row_begin, size_t row_end) {
+        std::vector<float> delta(nPhi);
+        for (size_t i = row_begin; i < row_end; i++) {
+            f.noise_row(i, 0, 1, delta.data(), nPhi);
+            addToRow(i, delta.data());
+        }
+    });
+}
 
-    for (size_t i = 0; i < nTheta; i++) {
-        for (size_t j = 0; j < nPhi; j++) {
-            data[i][j] += f.noise(i, j);
+// Two triangles per cell, rows [0, nTheta - 1), wrapping around in phi.
+// Each row writes its own slots, so rows are split across threads freely.
+std::vector<unsigned int> PlanetArray::gridIndices(size_t nTheta, size_t nPhi, unsigned threads)
+{
+    std::vector<unsigned int> indices(nTheta > 1 ? (nTheta - 1) * nPhi * 6 : 0);
+
+    parallelRows(nTheta > 1 ? nTheta - 1 : 0, threads, [&](size_t row_begin, size_t row_end) {
+        for (size_t i = row_begin; i < row_end; ++i) {
+            unsigned int* cell = indices.data() + i * nPhi * 6;
+            for (size_t j = 0; j < nPhi; ++j) {
+                size_t next_j = (j + 1) % nPhi;
+                unsigned int idx0 = i * nPhi + j;
+                unsigned int idx1 = (i + 1) * nPhi + j;
+                unsigned int idx2 = (i + 1) * nPhi + next_j;
+                unsigned int idx3 = i * nPhi + next_j;
+
+                // First triangle.
+                *cell++ = idx0;
+                *cell++ = idx1;
+                *cell++ = idx2;
+
+                // Second triangle.
+                *cell++ = idx0;
+                *cell++ = idx2;
+                *cell++ = idx3;
+            }
         }
+    });
+    return indices;
+}
+
+size_t PlanetArray::ringColumns(size_t i, size_t nTheta, size_t nPhi)
+{
+    if (i == 0 || i + 1 >= nTheta)
+        return 1;
+    double theta = M_PI * static_cast<double>(i) / (nTheta - 1);
+    size_t cols = static_cast<size_t>(std::ceil(nPhi * std::sin(theta) / 4.0)) * 4;
+    return std::clamp<size_t>(cols, std::min<size_t>(4, nPhi), nPhi);
+}
+
+std::vector<size_t> PlanetArray::ringOffsets(size_t nTheta, size_t nPhi)
+{
+    std::vector<size_t> offsets(nTheta + 1, 0);
+    for (size_t i = 0; i < nTheta; ++i)
+        offsets[i + 1] = offsets[i] + ringColumns(i, nTheta, nPhi);
+    return offsets;
+}
+
+size_t PlanetArray::vertexCount(GridLayout layout, size_t nTheta, size_t nPhi)
+{
+    switch (layout) {
+        case GridLayout::LatLong:        return nTheta * nPhi;
+        case GridLayout::ReducedLatLong: return ringOffsets(nTheta, nPhi).back();
+        case GridLayout::SkirtedPatch:   return nTheta * nTheta + (nTheta > 1 ? 4 * (nTheta - 1) : 0);
     }
+    throw std::invalid_argument("Unknown grid layout");
 }
 
-// Access element using angular coordinates in radians.
-// theta should be in [0, pi] and phi in [0, 2*pi).
-double& PlanetArray::operator()(double theta, double phi) {
-    size_t row = angleToIndex(theta, 0.0, M_PI, nTheta);
-    size_t col = angleToIndex(phi, 0.0, 2 * M_PI, nPhi);
-    return data[row][col];
+void PlanetArray::setLayout(GridLayout layout)
+{
+    if (layout == GridLayout::SkirtedPatch)
+        throw std::invalid_argument("PlanetArray only builds latitude/longitude grids");
+    m_layout = layout;
+}
+
+// Each pair of neighbouring rings is zipped by walking both eastwards from
+// phi = 0, always stepping the ring whose next vertex comes first. A pole
+// (a ring of one vertex) never steps, which turns its strip into a fan.
+// Winding matches gridIndices().
+std::vector<unsigned int> PlanetArray::reducedGridIndices(size_t nTheta, size_t nPhi)
+{
+    std::vector<size_t> offsets = ringOffsets(nTheta, nPhi);
+    std::vector<unsigned int> indices;
+    indices.reserve(offsets.back() * 6);
+
+    for (size_t i = 0; i + 1 < nTheta; ++i) {
+        size_t a = offsets[i], na = offsets[i + 1] - a;
+        size_t b = offsets[i + 1], nb = offsets[i + 2] - b;
+        size_t steps_a = na > 1 ? na : 0, steps_b = nb > 1 ? nb : 0;
+        size_t ka = 0, kb = 0;
+        while (ka < steps_a || kb < steps_b) {
+            bool step_a = kb == steps_b || (ka < steps_a && (ka + 1) * nb < (kb + 1) * na);
+            unsigned int va = a + ka % na, vb = b + kb % nb;
+            if (step_a) {
+                indices.insert(indices.end(), {va, vb, static_cast<unsigned int>(a + (ka + 1) % na)});
+                ka++;
+            } else {
+                indices.insert(indices.end(), {va, vb, static_cast<unsigned int>(b + (kb + 1) % nb)});
+                kb++;
+            }
+        }
+    }
+    return indices;
 }
 
-const double& PlanetArray::operator()(double theta, double phi) const {
+// Access element using angular coordinates in radians.
+// theta should be in [0, pi] and phi in [0, 2*pi).
+double PlanetArray::operator()(double theta, double phi) const {
     size_t row = angleToIndex(theta, 0.0, M_PI, nTheta);
     size_t col = angleToIndex(phi, 0.0, 2 * M_PI, nPhi);
-    return data[row][col];
+    return at(row, col);
 }
 
 size_t PlanetArray::angleToIndex(double angle, double minAngle, double maxAngle, size_t divisions){
@@ -51,16 +250,19 @@ size_t PlanetArray::angleToIndex(double angle, double minAngle, double maxAngle,
 
 // Specialization for SFloat3.
 template <>
-std::pair<std::vector<SFloat3>, std::vector<unsigned int>> PlanetArray::mesh<SFloat3>()
+std::vector<SFloat3> PlanetArray::vertices<SFloat3>()
 {
+    if (m_layout != GridLayout::LatLong)
+        throw std::logic_error("SFloat3 planets are only built as LatLong grids");
     std::vector<SFloat3> vertices;
-    std::vector<unsigned int> indices;
+    std::vector<float> scratch(nPhi);
     // Generate vertices.
     for (size_t i = 0; i < nTheta; ++i) {
         double theta = M_PI * static_cast<double>(i) / (nTheta - 1);
+        auto heights = rowHeights(i, scratch.data());
         for (size_t j = 0; j < nPhi; ++j) {
             double phi = 2.0 * M_PI * static_cast<double>(j) / nPhi;
-            double r = data[i][j];
+            double r = heights[j];
 
             // Convert from spherical to Cartesian coordinates.
             double x = r * sin(theta) * cos(phi);
@@ -71,48 +273,26 @@ std::pair<std::vector<SFloat3>, std::vector<unsigned int>> PlanetArray::mesh<SFl
         }
     }
 
-    // Generate indices for triangle mesh.
-    for (size_t i = 0; i < nTheta - 1; ++i) {
-        for (size_t j = 0; j < nPhi; ++j) {
-            size_t next_j = (j + 1) % nPhi;
-            unsigned int idx0 = i * nPhi + j;
-            unsigned int idx1 = (i + 1) * nPhi + j;
-            unsigned int idx2 = (i + 1) * nPhi + next_j;
-            unsigned int idx3 = i * nPhi + next_j;
-
-            // First triangle.
-            indices.push_back(idx0);
-            indices.push_back(idx1);
-            indices.push_back(idx2);
-
-            // Second triangle.
-            indices.push_back(idx0);
-            indices.push_back(idx2);
-            indices.push_back(idx3);
-        }
-    }
-    // TODO: Fill vertices and indices with the mesh data appropriate for SFloat3.
-    // For example:
-    // vertices.push_back({ x, y, z });
-    // indices.push_back(0);
-
-    return {vertices, indices};
+    return vertices;
 }
 
 // Specialization for SFloat3T2.
 template <>
-std::pair<std::vector<SFloat3T2>, std::vector<unsigned int>> PlanetArray::mesh<SFloat3T2>()
+std::vector<SFloat3T2> PlanetArray::vertices<SFloat3T2>()
 {
+    if (m_layout != GridLayout::LatLong)
+        throw std::logic_error("SFloat3T2 planets are only built as LatLong grids");
     std::vector<SFloat3T2> vertices;
-    std::vector<unsigned int> indices;
+    std::vector<float> scratch(nPhi);
     // Generate vertices.
     for (size_t i = 0; i < nTheta; ++i) {
         // theta from 0 to pi.
         double theta = M_PI * static_cast<double>(i) / (nTheta - 1);
+        auto heights = rowHeights(i, scratch.data());
         for (size_t j = 0; j < nPhi; ++j) {
             // phi from 0 to 2*pi.
             double phi = 2.0 * M_PI * static_cast<double>(j) / nPhi;
-            double r = data[i][j];
+            double r = heights[j];
 
             // Convert spherical to Cartesian coordinates.
             double x = r * sin(theta) * cos(phi);
@@ -130,182 +310,357 @@ std::pair<std::vector<SFloat3T2>, std::vector<unsigned int>> PlanetArray::mesh<S
         }
     }
 
-    // Generate indices for triangle mesh.
-    for (size_t i = 0; i < nTheta - 1; ++i) {
-        for (size_t j = 0; j < nPhi; ++j) {
-            size_t next_j = (j + 1) % nPhi;
-            unsigned int idx0 = i * nPhi + j;
-            unsigned int idx1 = (i + 1) * nPhi + j;
-            unsigned int idx2 = (i + 1) * nPhi + next_j;
-            unsigned int idx3 = i * nPhi + next_j;
-            
-            // First triangle.
-            indices.push_back(idx0);
-            indices.push_back(idx1);
-            indices.push_back(idx2);
-            
-            // Second triangle.
-            indices.push_back(idx0);
-            indices.push_back(idx2);
-            indices.push_back(idx3);
-        }
-    }
-    // TODO: Fill vertices and indices with the mesh data appropriate for SFloat3T2.
-    // This could include texture coordinates in addition to position.
-    
-    return {vertices, indices};
+    return vertices;
 }
 
 // Specialization for P_N_C.
 template <>
-std::pair<std::vector<P_N_C>, std::vector<unsigned int>> PlanetArray::mesh<P_N_C>()
+std::vector<P_N_C> PlanetArray::vertices<P_N_C>()
 {
-    std::vector<P_N_C> vertices;
-    std::vector<unsigned int> indices;
+    std::vector<P_N_C> vertices(vertexCount(m_layout, nTheta, nPhi));
+    shadeVertices([&](size_t k, const glm::vec3& pos, const glm::vec3& norm, const glm::vec3& col) {
+        vertices[k] = P_N_C(pos, norm, col);
+    });
+    return vertices;
+}
 
-    // Generate vertices.
-    // Loop over the angular grid.
+// Specialization for P_N_C_Packed, relative to {origin, packExtent()}.
+template <>
+std::vector<P_N_C_Packed> PlanetArray::vertices<P_N_C_Packed>()
+{
+    PackedBounds bounds{glm::vec3(0.0f), static_cast<float>(packExtent())};
+    std::vector<P_N_C_Packed> vertices(vertexCount(m_layout, nTheta, nPhi));
+    shadeVertices([&](size_t k, const glm::vec3& pos, const glm::vec3& norm, const glm::vec3& col) {
+        vertices[k] = P_N_C_Packed(pos, norm, col, bounds);
+    });
+    return vertices;
+}
 
-    FractalNoise col_noise = FractalNoise(mt_gen(), nTheta, nTheta, 2. / nTheta);
+double PlanetArray::packExtent() const
+{
+    if (m_format == HeightFormat::Quantized16)
+        return nominal_rad + m_quant_step * INT16_MAX;
 
+    std::vector<float> scratch(nPhi);
+    double extent = 0.0;
     for (size_t i = 0; i < nTheta; ++i) {
-        // theta goes from 0 to pi.
-        double theta = M_PI * static_cast<double>(i) / (nTheta - 1);
-        for (size_t j = 0; j < nPhi; ++j) {
-            // phi goes from 0 to 2*pi.
-            double phi = 2.0 * M_PI * static_cast<double>(j) / nPhi;
-            // Use the stored planet data (e.g. height/scale factor).
-            double r = data[i][j];
+        for (float h : rowHeights(i, scratch.data()))
+            extent = std::max(extent, std::abs(static_cast<double>(h)));
+    }
+    return extent;
+}
 
-            // Compute 3D position from spherical coordinates.
-            double x = r * sin(theta) * cos(phi);
-            double y = r * cos(theta);
-            double z = r * sin(theta) * sin(phi);
+// Biome color of a sample height_above_nom above the nominal radius, at
+// latitude (0 at one pole, 1 at the other), given the color noise there.
+static glm::vec3 surfaceColor(double height_above_nom, float biome_noise, float polar_noise, float latitude)
+{
+    // Biome colors with natural variations
+    glm::vec3 col;
+
+    // Define biome thresholds (adjust based on your height distribution)
+    const float DEEP_OCEAN = -0.f;
+    const float SHALLOW_OCEAN = 0.2f;
+    const float BEACH = 0.30f;
+    const float GRASSLAND = 0.40f;
+    const float FOREST = 0.55f;
+    const float MOUNTAIN_BASE = 0.65f;
+    const float SNOW_LINE = 0.75f;
+
+    // Ocean biomes
+    if (height_above_nom < DEEP_OCEAN) {
+        col = glm::vec3(0.0f, 0.1f, 0.3f);  // Deep ocean
+    } else if (height_above_nom < SHALLOW_OCEAN) {
+        float t = (height_above_nom - DEEP_OCEAN) / (SHALLOW_OCEAN - DEEP_OCEAN);
+        col = glm::mix(glm::vec3(0.0f, 0.1f, 0.3f), glm::vec3(0.2f, 0.5f, 0.9f), t);
+    } 
+    // Coastal biomes
+    else if (height_above_nom < BEACH) {
+        col = glm::vec3(0.96f, 0.96f, 0.7f);  // Sandy beach
+    } 
+    // Lowland biomes
+    else if (height_above_nom < GRASSLAND) {
+        // Add grassland variation using noise
+        float noise = biome_noise * 0.05f;
+        col = glm::vec3(0.1f + noise, 0.7f + noise, 0.2f);
+    } 
+    // Mid-elevation biomes
+    else if (height_above_nom < FOREST) {
+        // Forest with natural color variation
+        float noise = biome_noise * 0.02f;
+        col = glm::vec3(0.0f, 0.3f + noise, 0.05f);
+    } 
+    // Highland biomes
+    else if (height_above_nom < MOUNTAIN_BASE) {
+        // Rocky mountains with stratification
+        float rock_variation = biome_noise * 0.03f;
+        col = glm::vec3(0.4f + rock_variation, 0.4f + rock_variation, 0.4f);
+    } 
+    // Alpine biomes
+    else if (height_above_nom < SNOW_LINE) {
+        float t = (height_above_nom - MOUNTAIN_BASE) / (SNOW_LINE - MOUNTAIN_BASE);
+        glm::vec3 rock(0.5f, 0.5f, 0.5f);
+        glm::vec3 snow(1.0f, 1.0f, 1.0f);
+        col = glm::mix(rock, snow, t * 1.5f);  // Accelerated transition
+    } 
+    // Snow caps
+    else {
+        col = glm::vec3(1.0f, 1.0f, 1.0f);  // Pure snow
+    }
+
+
+    // Parameters
+    float polar_band = 0.18f;   // Fraction of planet covered by polar ice at each pole (center of band)
+    float polar_fade = 0.10f;   // Fraction for smooth transition/fade
+    float noise_strength = 0.1f; // How much the boundary "wiggles" (fraction of planet)
+
+    // Normalized latitude: 0 at south pole, 1 at north pole
+    float to_pole = std::min(latitude, 1.0f - latitude);
+
+    // 1D Perlin noise based on phi (longitude)
+    // float phi_norm = float(j) / float(nPhi); // [0,1]
+    float noise = polar_noise; // [-1,1] or [0,1] depending on your noise implementation
+
+    // Offset the polar band with noise
+    float polar_band_noisy = polar_band + noise * noise_strength;
+
+    // Compute smooth polar mask (1.0 = full ice, 0.0 = no ice)
+    float polar_mask = 0.0f;
+    if (to_pole < polar_band_noisy) {
+        float edge = polar_band_noisy - polar_fade;
+        if (to_pole < edge) {
+            polar_mask = 1.0f;
+        }
+    }
 
-            // Compute normal: normalize the position vector.
-            double len = sqrt(x * x + y * y + z * z);
-            double nx = (len != 0.0) ? x / len : 0.0;
-            double ny = (len != 0.0) ? y / len : 0.0;
-            double nz = (len != 0.0) ? z / len : 0.0;
-
-            // Biome colors with natural variations
-            glm::vec3 col;
-            double height_above_nom = r - nominal_rad;
-
-            double u = 32 * (i / (double) nTheta) + .5;
-            double v = 32 * (j / (double) nPhi)   + .5;
-
-            // Define biome thresholds (adjust based on your height distribution)
-            const float DEEP_OCEAN = -0.f;
-            const float SHALLOW_OCEAN = 0.2f;
-            const float BEACH = 0.30f;
-            const float GRASSLAND = 0.40f;
-            const float FOREST = 0.55f;
-            const float MOUNTAIN_BASE = 0.65f;
-            const float SNOW_LINE = 0.75f;
-
-            // Ocean biomes
-            if (height_above_nom < DEEP_OCEAN) {
-                col = glm::vec3(0.0f, 0.1f, 0.3f);  // Deep ocean
-            } else if (height_above_nom < SHALLOW_OCEAN) {
-                float t = (height_above_nom - DEEP_OCEAN) / (SHALLOW_OCEAN - DEEP_OCEAN);
-                col = glm::mix(glm::vec3(0.0f, 0.1f, 0.3f), glm::vec3(0.2f, 0.5f, 0.9f), t);
-            } 
-            // Coastal biomes
-            else if (height_above_nom < BEACH) {
-                col = glm::vec3(0.96f, 0.96f, 0.7f);  // Sandy beach
-            } 
-            // Lowland biomes
-            else if (height_above_nom < GRASSLAND) {
-                // Add grassland variation using noise
-                float noise = col_noise.noise(u, v) * 0.05f;
-                col = glm::vec3(0.1f + noise, 0.7f + noise, 0.2f);
-            } 
-            // Mid-elevation biomes
-            else if (height_above_nom < FOREST) {
-                // Forest with natural color variation
-                float noise = col_noise.noise(u, v) * 0.02f;
-                col = glm::vec3(0.0f, 0.3f + noise, 0.05f);
-            } 
-            // Highland biomes
-            else if (height_above_nom < MOUNTAIN_BASE) {
-                // Rocky mountains with stratification
-                float rock_variation = col_noise.noise(u, v) * 0.03f;
-                col = glm::vec3(0.4f + rock_variation, 0.4f + rock_variation, 0.4f);
-            } 
-            // Alpine biomes
-            else if (height_above_nom < SNOW_LINE) {
-                float t = (height_above_nom - MOUNTAIN_BASE) / (SNOW_LINE - MOUNTAIN_BASE);
-                glm::vec3 rock(0.5f, 0.5f, 0.5f);
-                glm::vec3 snow(1.0f, 1.0f, 1.0f);
-                col = glm::mix(rock, snow, t * 1.5f);  // Accelerated transition
-            } 
-            // Snow caps
-            else {
-                col = glm::vec3(1.0f, 1.0f, 1.0f);  // Pure snow
+    // Blend polar ice color with biome color
+    glm::vec3 polar_ice_color(0.8f, 0.92f, 1.0f);
+    col = glm::mix(col, polar_ice_color, polar_mask);
+    return col;
+}
+
+ShadingNoise PlanetArray::shadingNoise() const
+{
+    FractalNoise col_noise = colorNoise(m_seed, nTheta);
+    ShadingNoise noise{std::vector<int8_t>(nTheta * nPhi), polarNoise(col_noise, nPhi)};
+
+    parallelRows(nTheta, m_threads, [&](size_t row_begin, size_t row_end) {
+        std::vector<float> biome_noise(nPhi);
+        for (size_t i = row_begin; i < row_end; ++i) {
+            biomeNoiseRow(col_noise, i, nTheta, nPhi, biome_noise.data());
+            for (size_t j = 0; j < nPhi; ++j)
+                noise.biome[i * nPhi + j] = static_cast<int8_t>(std::lround(std::clamp(biome_noise[j], -1.0f, 1.0f) * 127.0f));
+        }
+    });
+    return noise;
+}
+
+// Computes every vertex's position, normal and biome color and hands them
+// to emit(index, pos, norm, col). Every row writes straight into its own
+// slots, so the output does not depend on how the rows are split between
+// threads.
+template <typename Emit>
+void PlanetArray::shadeVertices(Emit&& emit)
+{
+    // Generate vertices.
+    // Loop over the angular grid.
+
+    FractalNoise col_noise = colorNoise(m_seed, nTheta);
+    std::vector<float> polar_noise = polarNoise(col_noise, nPhi);
+    std::vector<size_t> offsets;
+    if (m_layout == GridLayout::ReducedLatLong)
+        offsets = ringOffsets(nTheta, nPhi);
+
+    parallelRows(nTheta, m_threads, [&](size_t row_begin, size_t row_end) {
+        std::vector<float> biome_noise(nPhi);
+        std::vector<float> scratch(nPhi);
+
+        for (size_t i = row_begin; i < row_end; ++i) {
+            // theta goes from 0 to pi.
+            double theta = M_PI * static_cast<double>(i) / (nTheta - 1);
+
+            // Biome variation for the whole row, sampled at (u, v) below.
+            biomeNoiseRow(col_noise, i, nTheta, nPhi, biome_noise.data());
+            auto heights = rowHeights(i, scratch.data());
+
+            auto shade = [&](size_t k, double phi, double r, float biome, float polar) {
+                // Compute 3D position from spherical coordinates.
+                double x = r * sin(theta) * cos(phi);
+                double y = r * cos(theta);
+                double z = r * sin(theta) * sin(phi);
+
+                // Compute normal: normalize the position vector.
+                double len = sqrt(x * x + y * y + z * z);
+                double nx = (len != 0.0) ? x / len : 0.0;
+                double ny = (len != 0.0) ? y / len : 0.0;
+                double nz = (len != 0.0) ? z / len : 0.0;
+
+                glm::vec3 col = surfaceColor(r - nominal_rad, biome, polar, float(i) / float(nTheta - 1));
+
+                // Store the vertex.
+                emit(k,
+                    glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)),
+                    glm::vec3(static_cast<float>(nx), static_cast<float>(ny), static_cast<float>(nz)),
+                    col
+                );
+            };
+
+            if (m_layout == GridLayout::LatLong) {
+                for (size_t j = 0; j < nPhi; ++j) {
+                    // phi goes from 0 to 2*pi.
+                    double phi = 2.0 * M_PI * static_cast<double>(j) / nPhi;
+                    // Use the stored planet data (e.g. height/scale factor).
+                    shade(i * nPhi + j, phi, heights[j], biome_noise[j], polar_noise[j]);
+                }
+                continue;
             }
 
-            
-            // Parameters
-            float polar_band = 0.18f;   // Fraction of planet covered by polar ice at each pole (center of band)
-            float polar_fade = 0.10f;   // Fraction for smooth transition/fade
-            float noise_strength = 0.1f; // How much the boundary "wiggles" (fraction of planet)
-
-            // Normalized latitude: 0 at south pole, 1 at north pole
-            float latitude = float(i) / float(nTheta - 1);
-            float to_pole = std::min(latitude, 1.0f - latitude);
-
-            // 1D Perlin noise based on phi (longitude)
-            // float phi_norm = float(j) / float(nPhi); // [0,1]
-            float noise = col_noise.noise(j + .5, .5); // [-1,1] or [0,1] depending on your noise implementation
-
-            // Offset the polar band with noise
-            float polar_band_noisy = polar_band + noise * noise_strength;
-
-            // Compute smooth polar mask (1.0 = full ice, 0.0 = no ice)
-            float polar_mask = 0.0f;
-            if (to_pole < polar_band_noisy) {
-                float edge = polar_band_noisy - polar_fade;
-                if (to_pole < edge) {
-                    polar_mask = 1.0f;
+            // Reduced rings read the same samples: a pole is the mean of its
+            // row, and every other vertex interpolates the two samples of
+            // its row on either side of it.
+            size_t cols = offsets[i + 1] - offsets[i];
+            if (cols == 1) {
+                double r = 0.0, biome = 0.0, polar = 0.0;
+                for (size_t j = 0; j < nPhi; ++j) {
+                    r += heights[j];
+                    biome += biome_noise[j];
+                    polar += polar_noise[j];
                 }
+                shade(offsets[i], 0.0, r / nPhi, static_cast<float>(biome / nPhi), static_cast<float>(polar / nPhi));
+                continue;
+            }
+            for (size_t k = 0; k < cols; ++k) {
+                double c = static_cast<double>(k) * nPhi / cols;
+                size_t j0 = std::min(static_cast<size_t>(c), nPhi - 1), j1 = (j0 + 1) % nPhi;
+                float t = static_cast<float>(c - j0);
+                double phi = 2.0 * M_PI * static_cast<double>(k) / cols;
+                shade(offsets[i] + k, phi, std::lerp(heights[j0], heights[j1], t),
+                      std::lerp(biome_noise[j0], biome_noise[j1], t), std::lerp(polar_noise[j0], polar_noise[j1], t));
             }
+        }
+    });
+}
+
+PlanetField::PlanetField(unsigned long long seed, size_t inTheta, size_t inPhi, double rad, double height_range)
+    : nTheta(inTheta), nPhi(inPhi), nominal_rad(rad), m_height_range(height_range),
+      m_color_noise(std::make_unique<FractalNoise>(colorNoise(seed, nTheta)))
+{
+    // The grid's octaves come first, so coarse patches match grid planets.
+    FractalNoise grid(seed, nTheta, nPhi, 2. / nTheta);
+    m_height_noise = std::make_unique<FractalNoise>(seed, nTheta, nPhi, 2. / nTheta, grid.octaves() + DETAIL_OCTAVES);
+}
 
-            // Blend polar ice color with biome color
-            glm::vec3 polar_ice_color(0.8f, 0.92f, 1.0f);
-            col = glm::mix(col, polar_ice_color, polar_mask);
+PlanetField::~PlanetField() = default;
 
-            // Assuming P_N_C is defined as {float x, y, z, nx, ny, nz, r, g, b},
-            // push the vertex.
-            vertices.push_back({
-                glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)),
-                glm::vec3(static_cast<float>(nx), static_cast<float>(ny), static_cast<float>(nz)),
-                col
-            });
-        }
+int PlanetField::maxOctaves() const
+{
+    return m_height_noise->octaves();
+}
+
+int PlanetField::octaves(double spacing) const
+{
+    // Noise coordinates are in grid rows.
+    double row = M_PI * nominal_rad / (nTheta - 1);
+    int count = 1;
+    while (count < maxOctaves() && row / m_height_noise->frequency(count) >= SAMPLES_PER_WAVELENGTH * spacing)
+        ++count;
+    return count;
+}
+
+void PlanetField::shade(std::span<const glm::vec3> dirs, std::span<P_N_C> out, double spacing) const
+{
+    if (out.size() != dirs.size())
+        throw std::invalid_argument("Output does not match the directions");
+
+    // Fractional grid coordinates of each direction, in PlanetArray's
+    // (row, column) sample units, and the color noise coordinates the grid
+    // would use there.
+    size_t n = dirs.size();
+    std::vector<float> gx(n), gy(n), bx(n), by(n), px(n), py(n, .5f);
+    for (size_t k = 0; k < n; ++k) {
+        double theta = std::acos(std::clamp(static_cast<double>(dirs[k].y), -1.0, 1.0));
+        double phi = std::atan2(static_cast<double>(dirs[k].z), static_cast<double>(dirs[k].x));
+        if (phi < 0.0)
+            phi += 2.0 * M_PI;
+        gx[k] = static_cast<float>(theta / M_PI * (nTheta - 1));
+        gy[k] = static_cast<float>(phi / (2.0 * M_PI) * nPhi);
+        bx[k] = static_cast<float>(32 * (gx[k] / (double) nTheta) + .5);
+        by[k] = static_cast<float>(.5 + gy[k] * (32. / nPhi));
+        px[k] = gy[k] + .5f;
     }
 
-    // Generate indices for a triangle mesh.
-    // For each cell in the grid, form two triangles.
-    for (size_t i = 0; i < nTheta - 1; ++i) {
-        for (size_t j = 0; j < nPhi; ++j) {
-            size_t next_j = (j + 1) % nPhi;
-            unsigned int idx0 = i * nPhi + j;
-            unsigned int idx1 = (i + 1) * nPhi + j;
-            unsigned int idx2 = (i + 1) * nPhi + next_j;
-            unsigned int idx3 = i * nPhi + next_j;
-            
-            // First triangle.
-            indices.push_back(idx0);
-            indices.push_back(idx1);
-            indices.push_back(idx2);
-            
-            // Second triangle.
-            indices.push_back(idx0);
-            indices.push_back(idx2);
-            indices.push_back(idx3);
+    int count = octaves(spacing);
+    std::vector<float> height(n), biome(n), polar(n);
+    m_height_noise->noise_n(gx.data(), gy.data(), height.data(), n, count);
+    m_color_noise->noise_n(bx.data(), by.data(), biome.data(), n);
+    m_color_noise->noise_n(px.data(), py.data(), polar.data(), n);
+
+    // Directions in the polar caps also sample the noise at their (x, z),
+    // scaled to grid rows and moved to a different spot for each pole.
+    double rows = (nTheta - 1) / M_PI;
+    std::vector<size_t> capped;
+    std::vector<float> cx, cy, cap;
+    for (size_t k = 0; k < n; ++k) {
+        if (std::abs(dirs[k].y) <= std::cos(POLE_CAP_OUTER))
+            continue;
+        double center = dirs[k].y > 0.0f ? 0.25 : 0.75;
+        capped.push_back(k);
+        cx.push_back(static_cast<float>(center * nTheta + dirs[k].x * rows));
+        cy.push_back(static_cast<float>(center * nPhi + dirs[k].z * rows));
+    }
+    cap.resize(capped.size());
+    m_height_noise->noise_n(cx.data(), cy.data(), cap.data(), capped.size(), count);
+    for (size_t c = 0; c < capped.size(); ++c) {
+        size_t k = capped[c];
+        double angle = std::acos(std::min(std::abs(static_cast<double>(dirs[k].y)), 1.0));
+        double t = std::clamp((angle - POLE_CAP_INNER) / (POLE_CAP_OUTER - POLE_CAP_INNER), 0.0, 1.0);
+        height[k] = static_cast<float>(std::lerp(static_cast<double>(cap[c]), static_cast<double>(height[k]), t * t * (3.0 - 2.0 * t)));
+    }
+
+    for (size_t k = 0; k < n; ++k) {
+        double r = nominal_rad + std::clamp(static_cast<double>(height[k]), -m_height_range, m_height_range);
+        glm::vec3 col = surfaceColor(r - nominal_rad, biome[k], polar[k], gx[k] / float(nTheta - 1));
+        out[k] = P_N_C(dirs[k] * static_cast<float>(r), dirs[k], col);
+    }
+}
+
+size_t skirtBorderVertex(size_t n, size_t k)
+{
+    size_t side = n - 1;
+    switch (k / side) {
+        case 0:  return k;                                  // row 0, left to right
+        case 1:  return (k - side) * n + side;              // column n - 1, downwards
+        case 2:  return side * n + (side - (k - 2 * side)); // row n - 1, right to left
+        default: return (side - (k - 3 * side)) * n;        // column 0, upwards
+    }
+}
+
+std::vector<unsigned int> skirtedPatchIndices(size_t n)
+{
+    std::vector<unsigned int> indices;
+    if (n < 2)
+        return indices;
+
+    // Two triangles per cell, as gridIndices() but without wrapping.
+    size_t side = n - 1;
+    indices.reserve(side * side * 6 + 4 * side * 6);
+    for (size_t i = 0; i < side; ++i) {
+        for (size_t j = 0; j < side; ++j) {
+            unsigned int idx0 = i * n + j;
+            unsigned int idx1 = (i + 1) * n + j;
+            unsigned int idx2 = (i + 1) * n + j + 1;
+            unsigned int idx3 = i * n + j + 1;
+            indices.insert(indices.end(), {idx0, idx1, idx2, idx0, idx2, idx3});
         }
     }
-    
-    return {vertices, indices};
-}
\ No newline at end of file
+
+    // One quad between each border edge and the skirt below it.
+    size_t ring = 4 * side;
+    unsigned int skirt = n * n;
+    for (size_t k = 0; k < ring; ++k) {
+        size_t next = (k + 1) % ring;
+        unsigned int b0 = skirtBorderVertex(n, k), b1 = skirtBorderVertex(n, next);
+        unsigned int s0 = skirt + k, s1 = skirt + next;
+        indices.insert(indices.end(), {b0, s0, b1, b1, s0, s1});
+    }
+    return indices;
+}
@@ -0,0 +1,143 @@
+#include "ProgramCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+// Bumped whenever the on-disk layout below changes.
+static constexpr uint32_t PROGRAM_CACHE_VERSION = 1;
+static constexpr char PROGRAM_MAGIC[8] = {'O', 'R', 'B', 'P', 'R', 'O', 'G', '\0'};
+
+namespace {
+
+struct FileHeader {
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t binaryFormat; // as glGetProgramBinary reported it
+    uint64_t key;
+    uint64_t bytes;        // of the binary following the header
+};
+
+// FNV-1a, folded into seedHash() so keys chain like MeshCache's.
+uint64_t hashString(uint64_t key, std::string_view text)
+{
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (unsigned char c : text) {
+        h ^= c;
+        h *= 0x100000001B3ull;
+    }
+    return seedHash(key, h);
+}
+
+std::string_view glString(GLenum name)
+{
+    auto s = reinterpret_cast<const char*>(glGetString(name));
+    return s ? std::string_view(s) : std::string_view();
+}
+
+} // namespace
+
+ProgramCache::ProgramCache(std::filesystem::path dir)
+    : m_dir(std::move(dir))
+{
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    m_enabled = formats > 0;
+
+    m_driver_key = hashString(PROGRAM_CACHE_VERSION, glString(GL_VENDOR));
+    m_driver_key = hashString(m_driver_key, glString(GL_RENDERER));
+    m_driver_key = hashString(m_driver_key, glString(GL_VERSION));
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_dir, ec);
+}
+
+uint64_t ProgramCache::programKey(std::string_view vertex_source, std::string_view fragment_source) const
+{
+    return hashString(hashString(m_driver_key, vertex_source), fragment_source);
+}
+
+std::filesystem::path ProgramCache::entryPath(uint64_t key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.prog", static_cast<unsigned long long>(key));
+    return m_dir / name;
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key)
+{
+    if (!m_enabled) {
+        m_misses++;
+        return false;
+    }
+
+    std::ifstream file(entryPath(key), std::ios::binary);
+    FileHeader header{};
+    bool ok = file && file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        && std::memcmp(header.magic, PROGRAM_MAGIC, sizeof(PROGRAM_MAGIC)) == 0
+        && header.formatVersion == PROGRAM_CACHE_VERSION && header.key == key
+        && header.bytes > 0 && header.bytes <= (64u << 20);
+    std::vector<char> binary;
+    if (ok) {
+        binary.resize(header.bytes);
+        ok = static_cast<bool>(file.read(binary.data(), static_cast<std::streamsize>(binary.size())));
+    }
+
+    GLint linked = GL_FALSE;
+    if (ok) {
+        // The driver may still refuse, e.g. after an update that kept its
+        // version string.
+        glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    }
+    if (linked != GL_TRUE) {
+        m_misses++;
+        return false;
+    }
+    m_hits++;
+    return true;
+}
+
+void ProgramCache::store(GLuint program, uint64_t key)
+{
+    if (!m_enabled)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+
+    FileHeader header{};
+    std::memcpy(header.magic, PROGRAM_MAGIC, sizeof(PROGRAM_MAGIC));
+    header.formatVersion = PROGRAM_CACHE_VERSION;
+    header.binaryFormat = format;
+    header.key = key;
+    header.bytes = static_cast<uint64_t>(written);
+
+    std::filesystem::path final_path = entryPath(key);
+    std::filesystem::path tmp_path = final_path;
+    tmp_path += "." + std::to_string(::getpid()) + ".tmp";
+    bool ok;
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        ok = file && file.write(reinterpret_cast<const char*>(&header), sizeof(header))
+            && file.write(binary.data(), written) && file.flush();
+    }
+
+    std::error_code ec;
+    if (ok)
+        std::filesystem::rename(tmp_path, final_path, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(tmp_path, ec);
+        return;
+    }
+    m_stores++;
+}
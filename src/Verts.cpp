@@ -61,6 +61,101 @@ P_N_C::P_N_C(const glm::vec3& p, const glm::vec3& n, const glm::vec3& c)
 P_N_C::P_N_C()
 {}
 
+glm::mat4 PackedBounds::frame() const
+{
+    glm::mat4 m(extent);
+    m[3] = glm::vec4(center, 1.0f);
+    return m;
+}
+
+void InstanceTransform::setAttribPointer()
+{
+    for (GLuint column = 0; column < 4; ++column) {
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                              (const void*)(offsetof(InstanceTransform, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(3 + column, 1);
+        glEnableVertexAttribArray(3 + column);
+    }
+    glVertexAttribPointer(7, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(InstanceTransform), (const void*)offsetof(InstanceTransform, tint));
+    glVertexAttribDivisor(7, 1);
+    glEnableVertexAttribArray(7);
+}
+
+void P_N_C_Packed::setAttribPointer()
+{
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(P_N_C_Packed), (const void*)offsetof(P_N_C_Packed, pos));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(P_N_C_Packed), (const void*)offsetof(P_N_C_Packed, norm));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(P_N_C_Packed), (const void*)offsetof(P_N_C_Packed, color));
+    glEnableVertexAttribArray(2);
+}
+
+static int16_t toSnorm16(float v)
+{
+    return static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint8_t toUnorm8(float v)
+{
+    return static_cast<uint8_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 255.0f));
+}
+
+P_N_C_Packed::P_N_C_Packed(const glm::vec3& p, const glm::vec3& n, const glm::vec3& c, const PackedBounds& bounds)
+{
+    glm::vec3 local = (p - bounds.center) / bounds.extent;
+    pos[0] = toSnorm16(local.x);
+    pos[1] = toSnorm16(local.y);
+    pos[2] = toSnorm16(local.z);
+    pos[3] = 0;
+
+    // Octahedral mapping: project onto |x| + |y| + |z| = 1 and fold the
+    // lower hemisphere over the diagonals.
+    glm::vec3 o = n / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+    glm::vec2 e(o.x, o.y);
+    if (o.z < 0.0f) {
+        e = glm::vec2((1.0f - std::abs(o.y)) * (o.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::abs(o.x)) * (o.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    norm[0] = toSnorm16(e.x);
+    norm[1] = toSnorm16(e.y);
+
+    color[0] = toUnorm8(c.x);
+    color[1] = toUnorm8(c.y);
+    color[2] = toUnorm8(c.z);
+    color[3] = 255;
+}
+
+P_N_C_Packed::P_N_C_Packed(const P_N_C& v, const PackedBounds& bounds)
+    : P_N_C_Packed(v.pos, v.norm, v.color, bounds)
+{}
+
+P_N_C_Packed::P_N_C_Packed()
+{}
+
+glm::vec3 P_N_C_Packed::position(const PackedBounds& bounds) const
+{
+    auto snorm = [](int16_t v) { return std::max(v / 32767.0f, -1.0f); };
+    return bounds.center + bounds.extent * glm::vec3(snorm(pos[0]), snorm(pos[1]), snorm(pos[2]));
+}
+
+P_N_C P_N_C_Packed::unpack(const PackedBounds& bounds) const
+{
+    auto snorm = [](int16_t v) { return std::max(v / 32767.0f, -1.0f); };
+
+    glm::vec3 p = position(bounds);
+
+    glm::vec2 e(snorm(norm[0]), snorm(norm[1]));
+    glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.0f) {
+        n.x = (1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    glm::vec3 c(color[0] / 255.0f, color[1] / 255.0f, color[2] / 255.0f);
+    return P_N_C(p, n, c);
+}
+
 void Model_P_N_C::setAttribPointer()
 {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Model_P_N_C), (const void*)offsetof(Model_P_N_C, pos));
@@ -1,5 +1,7 @@
 
 
+#include <chrono>
+
 #include "common.hpp"
 
 #include "VBO.hpp"
@@ -22,6 +24,20 @@
 
 #include "Sprite.hpp"
 
+#include "DrawList.hpp"
+
+#include "UploadRing.hpp"
+
+#include "UniformBuffer.hpp"
+
+#include "PlanetLoader.hpp"
+
+#include "DisplacedPlanet.hpp"
+
+#include "QuadtreePlanet.hpp"
+
+#include "InstancedSprite.hpp"
+
 // VAO class
 class VAO {
 public:
@@ -42,8 +58,9 @@ int main() {
         std::cerr << "Failed to initialize GLFW\n";
         return -1;
     }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // 4.3 for glMultiDrawElementsIndirect
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     // Create window
@@ -82,27 +99,125 @@ int main() {
     VAO vao;
     vao.bind();
 
-    DynVBO<P_N_C> dyn_vbo = DynVBO<P_N_C>(3e6, 3e5);
-
-    // DynIBO creation and data loading
-    DynIBO dyn_ibo(3e7 * 5, 3e6);
-
-    //std::cout << "gonna make a planet" << std::endl;
-    Planet planet = Planet(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), std::make_shared<DynVBO<P_N_C>>(dyn_vbo), std::make_shared<DynIBO>(dyn_ibo), 
-            mt_gen());
-    //std::cout << "made a planet" << std::endl;
-    planet.ship();
-
-    Planet planet2 = Planet(glm::vec3(100.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), std::make_shared<DynVBO<P_N_C>>(dyn_vbo), std::make_shared<DynIBO>(dyn_ibo), 
-            mt_gen());
-    planet2.ship();
+    // How planets are built and drawn: meshed on the CPU into PlanetVertex,
+    // displaced on the GPU from height textures, or as a cube-sphere
+    // quadtree of PlanetVertex patches refined around the camera
+    enum class PlanetMode { Meshed, Displaced, Quadtree };
+    constexpr PlanetMode PLANET_MODE = PlanetMode::Quadtree;
+
+    // Meshed planets use 16-byte packed vertices; P_N_C (36 bytes) and
+    // PNC_simple remain available by switching this
+    using PlanetVertex = P_N_C_Packed;
+    constexpr bool PACKED_PLANETS = std::is_same_v<PlanetVertex, P_N_C_Packed>;
+    // Meshed planets collapse the poles and thin out the rings towards them;
+    // GridLayout::LatLong keeps nPhi vertices on every row
+    constexpr GridLayout PLANET_LAYOUT = GridLayout::ReducedLatLong;
+
+    // Vertex and index pools start small and grow to fit what gets shipped
+    auto dyn_vbo = std::make_shared<DynVBO<PlanetVertex>>(1 << 16);
+    auto dyn_ibo = std::make_shared<DynIBO>(1 << 20);
+    dyn_vbo->onResize([](GLuint, size_t capacity) {
+        std::cout << "Vertex pool grown to " << capacity << " vertices" << std::endl;
+    });
+    dyn_ibo->onResize([](GLuint, size_t capacity) {
+        std::cout << "Index pool grown to " << capacity << " indices" << std::endl;
+    });
 
+    // One model matrix and tint per entity or instance (attributes 3-7), so
+    // it is set up while the VAO is bound like the vertex pool
+    auto transforms = std::make_shared<TransformPool>();
+
+    // Both pools upload through one persistently mapped staging ring
+    auto upload_ring = std::make_shared<UploadRing>();
+    dyn_vbo->setUploadRing(upload_ring);
+    dyn_ibo->setUploadRing(upload_ring);
+
+    // Index lists shared between planets of the same resolution
+    auto topologies = std::make_shared<TopologyCache>(dyn_ibo);
+
+    // Persistent indirect draw commands, patched by entities when they ship
+    auto draw_list = std::make_shared<DrawList>();
+
+    // Planets are generated on a worker and uploaded a slice per frame, so
+    // the window renders right away and they pop in when ready
+    BasicPlanetLoader<BasicPlanet<PlanetVertex, PLANET_LAYOUT>> planets({dyn_vbo, dyn_ibo, topologies, draw_list, transforms});
+    BasicPlanetLoader<DisplacedPlanet> displaced_planets({topologies, transforms});
+    // Meshes of previously seen planets come from disk instead
+    auto mesh_cache = std::make_shared<MeshCache>("./cache/planets");
+    planets.setCache(mesh_cache);
+    displaced_planets.setCache(mesh_cache);
+    // Quadtree planets build their own patches as the camera needs them
+    std::vector<std::unique_ptr<QuadtreePlanet<PlanetVertex>>> lod_planets;
+    for (glm::vec3 pos : {glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(100.0f, 0.0f, 0.0f)}) {
+        if constexpr (PLANET_MODE == PlanetMode::Displaced)
+            displaced_planets.enqueue(pos, glm::vec3(0.0f, 0.0f, 0.0f), mt_gen());
+        else if constexpr (PLANET_MODE == PlanetMode::Quadtree)
+            lod_planets.push_back(std::make_unique<QuadtreePlanet<PlanetVertex>>(pos, mt_gen(), dyn_vbo, dyn_ibo, topologies,
+                                                                                 draw_list, transforms));
+        else
+            planets.enqueue(pos, glm::vec3(0.0f, 0.0f, 0.0f), mt_gen());
+    }
 
-    Texture earth_texture("./8081_earthmap10k.jpg");
-    earth_texture.bind();
+    // An asteroid belt around the first planet: one small rock mesh drawn
+    // ASTEROIDS times by a single indirect command, each rock scaled, turned,
+    // placed and tinted through its own transform slot. The rocks are laid
+    // out once; culling only sees the draw's one sphere around the belt
+    constexpr bool ASTEROID_BELT = true;
+    constexpr size_t ASTEROIDS = 100000;
+    constexpr uint64_t ASTEROID_STREAM = 0xA57E;
+    std::unique_ptr<InstancedSprite<PlanetVertex>> asteroids;
+    if constexpr (ASTEROID_BELT) {
+        auto rock = createSpherePNC(1.0f, 0.0f, 0.0f, 8, 6);
+        ChunkOffsets rock_chunks;
+        optimizeMesh(rock, rock_chunks);
+        asteroids = std::make_unique<InstancedSprite<PlanetVertex>>(glm::vec3(0.0f), glm::vec3(0.0f), std::move(rock), ASTEROIDS, dyn_vbo,
+                                                                    dyn_ibo, transforms, std::move(rock_chunks));
+        // The belt takes a seed like a planet does; its rocks come from a
+        // stream derived from that seed, not from mt_gen itself
+        std::mt19937_64 belt_gen(seedHash(mt_gen(), ASTEROID_STREAM));
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<glm::mat4> models(ASTEROIDS);
+        std::vector<glm::vec4> tints(ASTEROIDS);
+        for (size_t k = 0; k < ASTEROIDS; ++k) {
+            float angle = 2.0f * PI * unit(belt_gen);
+            float radius = 60.0f + 20.0f * unit(belt_gen);
+            glm::vec3 pos(radius * cosf(angle), 4.0f * (unit(belt_gen) - 0.5f), radius * sinf(angle));
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
+            model = glm::rotate(model, 2.0f * PI * unit(belt_gen), glm::normalize(glm::vec3(unit(belt_gen), unit(belt_gen), unit(belt_gen)) + glm::vec3(0.01f)));
+            models[k] = glm::scale(model, glm::vec3(0.1f) + 0.3f * glm::vec3(unit(belt_gen), unit(belt_gen), unit(belt_gen)));
+            float grey = 0.5f + 0.3f * unit(belt_gen);
+            tints[k] = glm::vec4(grey * (0.9f + 0.2f * unit(belt_gen)), grey, grey * 0.85f, 1.0f);
+        }
+        asteroids->setInstances(models, tints);
+        asteroids->setDrawList(draw_list);
+        asteroids->ship();
+    }
 
-    Shader simple_shad = Shader("./shad/PNC_simple");
+    // PNC_simple samples no texture, so the 10k earth map is no longer
+    // decoded before the first frame
+
+    // Linked programs are cached per driver, so warm starts compile nothing
+    ProgramCache program_cache("./cache/programs");
+    auto shaders_start = std::chrono::steady_clock::now();
+    Shader simple_shad = Shader(PACKED_PLANETS ? "./shad/PNC_packed" : "./shad/PNC_simple", &program_cache);
+    Shader displaced_shad = Shader("./shad/PNC_displaced", &program_cache);
+    ProgramCacheStats program_stats = program_cache.stats();
+    std::cout << "Shaders: " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaders_start).count()
+              << " ms, " << program_stats.hits << " from cache, " << program_stats.misses << " compiled ("
+              << (program_stats.hits > 0 && program_stats.misses == 0 ? "warm" : "cold") << " start)" << std::endl;
+    // Displaced planets read no vertex attributes but their model matrix,
+    // just the index pool
+    VAO displaced_vao;
+    displaced_vao.bind();
+    transforms->bindAttributes();
+    vao.bind();
     
+    // Per-frame uniforms live in one buffer every shader reads
+    UniformBuffer<FrameUniforms> frame_uniforms;
+    simple_shad.bindBlock("Frame", FRAME_UNIFORM_BINDING);
+    displaced_shad.bindBlock("Frame", FRAME_UNIFORM_BINDING);
+    DisplacedPlanet::Uniforms displaced_uniforms(displaced_shad);
+
     simple_shad.bind();
 
     //Texture earth_texture("./8081_earthmap10k.jpg");
@@ -134,38 +249,109 @@ int main() {
     //simple_tex_shad.setInt("ourTexture", 0);
 
     // Render loop
+    const size_t COMPACT_BYTES_PER_FRAME = 4 << 20;
+    const size_t UPLOAD_BYTES_PER_FRAME = 8 << 20;
+    bool cache_reported = false;
+    CullStats reported_cull;
+    OcclusionBuffer occlusion;
     float theta = 0.0;
     while (!glfwWindowShouldClose(window)) {
 
-        glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 view = camera->GetViewMatrix();
         glm::mat4 projection = camera->GetProjectionMatrix(800.0f, 600.0f);
    
 
-        glm::mat4 MVP = projection * view * model;
+        // Entities add their own model matrix from the transform pool
+        glm::mat4 MVP = projection * view;
         theta += .01 * 10;
-        simple_shad.setMat4f("MVP", &MVP[0][0]);
-        simple_shad.setFloat("theta", theta);
+        FrameUniforms frame;
+        frame.MVP = MVP;
+        frame.eye = glm::vec4(camera->Position, 1.0f);
+        frame.theta = theta;
+        frame_uniforms.update(frame);
+        frame_uniforms.bind(FRAME_UNIFORM_BINDING);
+        simple_shad.bind();
         
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
         vao.bind();
-        dyn_vbo.bind();
-        dyn_ibo.bind();
-
-        // Example: Draw using glMultiDrawElements for multiple blocks
-        // Suppose you have arrays of counts and offsets for each block
-        // Replace these with your actual data
-        std::vector<GLsizei> counts ;// = {planet.numIndicies()}; // Number of indices per block
-        std::vector<void*> offsets  ;//=  {nullptr}; // Offset for each block (nullptr for start)
-        
-        planet.addDrawCallData(counts, offsets);
-        planet2.addDrawCallData(counts, offsets);
 
-        // Draw multiple blocks (here only one block as example)
-        glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), counts.size());
+        // Move a bounded slice of finished planets onto the GPU
+        size_t uploaded = planets.pump(UPLOAD_BYTES_PER_FRAME);
+        uploaded += displaced_planets.pump(UPLOAD_BYTES_PER_FRAME - std::min(uploaded, UPLOAD_BYTES_PER_FRAME));
+        // Split and merge patches for this frame's camera
+        for (auto& planet : lod_planets)
+            uploaded += planet->update(*camera, glm::vec2(800.0f, 600.0f), UPLOAD_BYTES_PER_FRAME - std::min(uploaded, UPLOAD_BYTES_PER_FRAME));
+        if (!cache_reported && planets.pending() == 0 && displaced_planets.pending() == 0) {
+            MeshCacheStats stats = mesh_cache->stats();
+            std::cout << "Mesh cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                      << stats.bytesMapped << " bytes mapped" << std::endl;
+            for (auto& planet : displaced_planets.planets())
+                std::cout << "Displaced planet: " << planet->gpuBytes() << " bytes of textures" << std::endl;
+            cache_reported = true;
+        }
+
+        // Slide live geometry towards the front of the pools a little at a
+        // time, so despawned entities do not leave holes behind for good
+        dyn_vbo->compact(COMPACT_BYTES_PER_FRAME);
+        dyn_ibo->compact(COMPACT_BYTES_PER_FRAME);
+
+        dyn_vbo->bind();
+        dyn_ibo->bind();
+
+        // Planet cores hide whatever is behind them
+        occlusion.begin(view, projection);
+        for (auto& planet : planets.planets()) {
+            if (planet->core())
+                occlusion.rasterize(*planet->core());
+        }
+        for (auto& planet : displaced_planets.planets())
+            occlusion.rasterize(planet->core());
+        for (auto& planet : lod_planets)
+            occlusion.rasterize(planet->core());
+
+        // Switch off the draws whose bounds are out of view
+        Frustum frustum(projection * view);
+        CullStats cull_stats = draw_list->cull(frustum, camera->Position, &occlusion);
+        if constexpr (DEBUG_CULL) {
+            if (cull_stats.visible != reported_cull.visible || cull_stats.culled != reported_cull.culled) {
+                std::cout << "Culling: " << cull_stats.visible << " draws visible, " << cull_stats.culled << " culled ("
+                          << cull_stats.backfacing << " facing away, " << cull_stats.beyondHorizon << " past the horizon, "
+                          << cull_stats.occluded << " occluded)" << std::endl;
+                reported_cull = cull_stats;
+            }
+        }
+
+        // Model matrices of entities that moved, in one upload
+        transforms->upload();
+
+        // Every shipped entity's draws in one indirect multi-draw
+        draw_list->draw();
+
+        // Height-textured planets, one draw each over their shared grid
+        if (!displaced_planets.planets().empty()) {
+            displaced_vao.bind();
+            dyn_ibo->bind();
+            displaced_shad.bind();
+            for (auto& planet : displaced_planets.planets()) {
+                if (frustum.intersects(planet->bounds()) && !occlusion.occluded(planet->bounds()))
+                    planet->draw(displaced_uniforms);
+            }
+            vao.bind();
+        }
+
+        // Fence this frame's uploads so their staging space can be reused
+        upload_ring->submit();
+        if constexpr (DEBUG_UPLOAD) {
+            const UploadStats& stats = upload_ring->stats();
+            if (stats.fenceWaits > 0) {
+                std::cout << "Upload ring: " << stats.bytes << " bytes, " << stats.fenceWaits
+                          << " fence waits, " << stats.fenceWaitMs << " ms waiting" << std::endl;
+                upload_ring->resetStats();
+            }
+        }
         glfwSwapBuffers(window);
         glfwPollEvents();
 